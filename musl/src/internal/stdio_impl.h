@@ -47,6 +47,7 @@ struct _IO_FILE {
 	off_t shlim, shcnt;
 	FILE *prev_locked, *next_locked;
 	struct __locale_struct *locale;
+	uintptr_t lock_irq; /* Interrupt state saved by __lockfile */
 };
 
 size_t __stdio_read(FILE *, unsigned char *, size_t);
@@ -0,0 +1,36 @@
+#include <arch.h>
+
+#include "stdio_impl.h"
+#include "atomic.h"
+
+/* FILEs are shared by every CPU, and printf is called from interrupt
+   context too: the lock is a spinlock taken with interrupts disabled,
+   owned by a CPU rather than a thread. Its owner may take it again
+   (e.g. a failure path printing from within printf), in which case
+   nothing is done and the outer holder unlocks. */
+int __lockfile(FILE *f)
+{
+	uintptr_t flags = __arch_irq_save();
+	int owner = __arch_cpu_id() + 1;
+
+	if (f->lock == owner) {
+		__arch_irq_restore(flags);
+		return 0;
+	}
+
+	while (a_cas(&f->lock, 0, owner))
+		a_spin();
+
+	f->lock_irq = flags;
+
+	return 1;
+}
+
+void __unlockfile(FILE *f)
+{
+	uintptr_t flags = f->lock_irq;
+
+	a_store(&f->lock, 0);
+
+	__arch_irq_restore(flags);
+}
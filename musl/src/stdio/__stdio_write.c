@@ -1,12 +1,33 @@
 
 #include <arch.h>
+#include <string.h>
 
 #include "stdio_impl.h"
 
+/* Everything ends up in the debug device. Pending buffered data and
+   the new bytes are handed over as a single span whenever they fit
+   together in the buffer, so the backend can write them in bursts. */
 size_t __stdio_write(FILE *f, const unsigned char *buf, size_t len)
 {
-  while (len--)
-    __arch_debug_putchar (*buf++);
+  size_t written = len;
+  size_t pending;
 
-  return len;
+  if (len > 0 && len <= (size_t) (f->wend - f->wpos))
+  {
+    memcpy (f->wpos, buf, len);
+    f->wpos += len;
+    buf += len;
+    len = 0;
+  }
+
+  if ((pending = f->wpos - f->wbase) > 0)
+    __arch_debug_write (f->wbase, pending);
+
+  if (len > 0)
+    __arch_debug_write (buf, len);
+
+  f->wend = f->buf + f->buf_size;
+  f->wpos = f->wbase = f->buf;
+
+  return written;
 }
@@ -0,0 +1,33 @@
+#include "stdio_impl.h"
+
+extern FILE *volatile __stdout_used;
+extern FILE *volatile __stderr_used;
+
+int fflush(FILE *f)
+{
+	if (!f) {
+		int r = 0;
+		if (__stdout_used) r |= fflush(__stdout_used);
+		if (__stderr_used) r |= fflush(__stderr_used);
+		return r;
+	}
+
+	FLOCK(f);
+
+	/* If writing, flush output */
+	if (f->wpos > f->wbase) {
+		f->write(f, 0, 0);
+		if (!f->wpos) {
+			FUNLOCK(f);
+			return EOF;
+		}
+	}
+
+	/* Clear write mode */
+	f->wpos = f->wbase = f->wend = 0;
+
+	FUNLOCK(f);
+	return 0;
+}
+
+weak_alias(fflush, fflush_unlocked);
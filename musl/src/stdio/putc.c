@@ -2,11 +2,11 @@
 
 int putc(int c, FILE *f)
 {
-  const unsigned char buf[] = {c};
-
-  f->write (f, buf, 1);
-  
-  return c;
+	if (f->lock < 0 || !__lockfile(f))
+		return putc_unlocked(c, f);
+	c = putc_unlocked(c, f);
+	__unlockfile(f);
+	return c;
 }
 
 weak_alias(putc, _IO_putc);
@@ -3,9 +3,8 @@
 int puts(const char *s)
 {
 	int r;
-	
-	(void) fputs (s, stdout);
-        putc ('\n', stdout);
-	
+	FLOCK(stdout);
+	r = -(fputs(s, stdout) < 0 || putc_unlocked('\n', stdout) < 0);
+	FUNLOCK(stdout);
 	return r;
 }
@@ -10,7 +10,6 @@ static FILE f = {
 	.write = __stdio_write,
 	.seek = NULL,
 	.close = NULL,
-	.lock = -1,
 };
 FILE *const stderr = &f;
 FILE *volatile __stderr_used = &f;
@@ -1,16 +1,15 @@
 #include "stdio_impl.h"
 
-static unsigned char buf[UNGET];
+static unsigned char buf[BUFSIZ+UNGET];
 static FILE f = {
 	.buf = buf+UNGET,
-	.buf_size = 0,
+	.buf_size = sizeof buf-UNGET,
 	.fd = 1,
 	.flags = F_PERM | F_NORD,
-	.lbf = -1,
+	.lbf = '\n',
 	.write = __stdio_write,
 	.seek = NULL,
 	.close = NULL,
-	.lock = -1,
 };
 FILE *const stdout = &f;
 FILE *volatile __stdout_used = &f;
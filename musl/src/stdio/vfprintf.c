@@ -158,7 +158,7 @@ static void pop_arg(union arg *arg, int type, va_list *ap)
 
 static void out(FILE *f, const char *s, size_t l)
 {
-  f->write (f, (const unsigned char *) s, l);
+	if (!(f->flags & F_ERR)) __fwritex((void *)s, l, f);
 }
 
 static void pad(FILE *f, char c, int w, int l, int fl)
@@ -666,7 +666,7 @@ int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
 		return -1;
 	}
 
-
+	FLOCK(f);
 	olderr = f->flags & F_ERR;
 	if (f->mode < 1) f->flags &= ~F_ERR;
 	if (!f->buf_size) {
@@ -685,7 +685,7 @@ int vfprintf(FILE *restrict f, const char *restrict fmt, va_list ap)
 	}
 	if (f->flags & F_ERR) ret = -1;
 	f->flags |= olderr;
-
+	FUNLOCK(f);
 	va_end(ap2);
 	return ret;
 }
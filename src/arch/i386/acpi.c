@@ -0,0 +1,196 @@
+/*
+ *    acpi.c: ACPI table discovery
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <i386-acpi.h>
+#include <i386-apic.h>
+#include <i386-kmap.h>
+
+static const struct acpi_rsdp *acpi_rsdp;
+
+static int
+acpi_checksum (const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *) data;
+  uint8_t sum = 0;
+
+  while (size--)
+    sum += *bytes++;
+
+  return sum;
+}
+
+static const struct acpi_rsdp *
+acpi_scan_rsdp (uintptr_t phys, size_t size)
+{
+  const uint8_t *area;
+  size_t off;
+
+  if ((area = i386_kmap (phys, size, 0)) == NULL)
+    return NULL;
+
+  for (off = 0; off + ACPI_RSDP_V1_LENGTH <= size; off += 16)
+    if (memcmp (area + off, ACPI_RSDP_SIGNATURE, 8) == 0 &&
+        acpi_checksum (area + off, ACPI_RSDP_V1_LENGTH) == 0)
+      return (const struct acpi_rsdp *) (area + off);
+
+  return NULL;
+}
+
+static const struct acpi_rsdp *
+acpi_find_rsdp (void)
+{
+  const uint16_t *ebda_segment;
+  const struct acpi_rsdp *rsdp = NULL;
+
+  if ((ebda_segment = i386_kmap (ACPI_EBDA_SEGMENT_PTR, 2, 0)) != NULL &&
+      *ebda_segment != 0)
+    rsdp = acpi_scan_rsdp (*ebda_segment << 4, ACPI_EBDA_SEARCH_SIZE);
+
+  if (rsdp == NULL)
+    rsdp = acpi_scan_rsdp (
+      ACPI_BIOS_AREA_START,
+      ACPI_BIOS_AREA_END - ACPI_BIOS_AREA_START);
+
+  return rsdp;
+}
+
+static const struct acpi_sdt_header *
+acpi_map_table (uint64_t phys)
+{
+  const struct acpi_sdt_header *header;
+
+  if (phys >> 32)
+    return NULL;
+
+  if ((header = i386_kmap (phys, sizeof (struct acpi_sdt_header), 0)) == NULL)
+    return NULL;
+
+  return i386_kmap (phys, header->length, 0);
+}
+
+const struct acpi_sdt_header *
+i386_acpi_find_table (const char *signature)
+{
+  const struct acpi_sdt_header *root;
+  const struct acpi_sdt_header *table;
+  const uint8_t *entries;
+  unsigned int entry_size, count, i;
+  uint64_t phys;
+
+  if (acpi_rsdp == NULL && (acpi_rsdp = acpi_find_rsdp ()) == NULL)
+    return NULL;
+
+  /* Prefer the XSDT, which has 64-bit pointers */
+  if (acpi_rsdp->revision >= 2 && acpi_rsdp->xsdt != 0 && !(acpi_rsdp->xsdt >> 32))
+  {
+    root = acpi_map_table (acpi_rsdp->xsdt);
+    entry_size = sizeof (uint64_t);
+  }
+  else
+  {
+    root = acpi_map_table (acpi_rsdp->rsdt);
+    entry_size = sizeof (uint32_t);
+  }
+
+  if (root == NULL || acpi_checksum (root, root->length) != 0)
+    return NULL;
+
+  entries = (const uint8_t *) (root + 1);
+  count   = (root->length - sizeof (struct acpi_sdt_header)) / entry_size;
+
+  for (i = 0; i < count; ++i)
+  {
+    if (entry_size == sizeof (uint64_t))
+      memcpy (&phys, entries + i * entry_size, sizeof (uint64_t));
+    else
+      phys = *(const uint32_t *) (entries + i * entry_size);
+
+    if ((table = acpi_map_table (phys)) == NULL)
+      continue;
+
+    if (memcmp (table->signature, signature, 4) == 0 &&
+        acpi_checksum (table, table->length) == 0)
+      return table;
+  }
+
+  return NULL;
+}
+
+int
+i386_acpi_parse_madt (struct apic_config *config)
+{
+  const struct acpi_madt *madt;
+  const struct acpi_madt_entry *entry;
+  const uint8_t *p, *end;
+
+  if ((madt = (const struct acpi_madt *) i386_acpi_find_table (ACPI_MADT_SIGNATURE)) == NULL)
+    return -1;
+
+  config->lapic_phys = madt->lapic;
+  config->has_8259   = madt->flags & ACPI_MADT_PCAT_COMPAT;
+
+  p   = (const uint8_t *) (madt + 1);
+  end = (const uint8_t *) madt + madt->header.length;
+
+  while (p + 2 <= end)
+  {
+    entry = (const struct acpi_madt_entry *) p;
+
+    if (entry->length < 2 || p + entry->length > end)
+      break;
+
+    switch (entry->type)
+    {
+      case ACPI_MADT_LAPIC:
+        if (entry->lapic.flags & ACPI_MADT_LAPIC_ENABLED)
+          i386_apic_config_add_cpu (config, entry->lapic.apic_id);
+        break;
+
+      case ACPI_MADT_IOAPIC:
+        (void) i386_apic_config_add_ioapic (
+          config,
+          entry->ioapic.id,
+          entry->ioapic.address,
+          entry->ioapic.gsi_base);
+        break;
+
+      case ACPI_MADT_OVERRIDE:
+        if (entry->override.bus == 0 && entry->override.source < IRQ_COUNT)
+          i386_apic_config_set_isa_irq (
+            config,
+            entry->override.source,
+            entry->override.gsi,
+            entry->override.flags);
+        break;
+
+      case ACPI_MADT_LAPIC_ADDRESS:
+        if (!(entry->lapic_address.address >> 32))
+          config->lapic_phys = entry->lapic_address.address;
+        break;
+    }
+
+    p += entry->length;
+  }
+
+  return 0;
+}
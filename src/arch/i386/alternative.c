@@ -0,0 +1,88 @@
+/*
+ *    alternative.c: Boot-time instruction patching
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <i386-alternative.h>
+#include <i386-cpuid.h>
+
+#define ALT_OPCODE_CALL      0xe8
+#define ALT_OPCODE_JMP       0xe9
+#define ALT_OPCODE_JMP_SHORT 0xeb
+#define ALT_OPCODE_NOP       0x90
+
+extern struct alt_instr __start_altinstructions[];
+extern struct alt_instr __stop_altinstructions[];
+
+/* Not memcpy: memcpy itself may be a patch site */
+static void
+alt_copy (uint8_t *dest, const uint8_t *src, unsigned int len)
+{
+  while (len--)
+    *dest++ = *src++;
+}
+
+/* Leftover bytes are jumped over rather than executed as NOPs */
+static void
+alt_pad (uint8_t *site, unsigned int len)
+{
+  if (len > 2)
+  {
+    *site++ = ALT_OPCODE_JMP_SHORT;
+    *site++ = len - 2;
+    len -= 2;
+  }
+
+  while (len--)
+    *site++ = ALT_OPCODE_NOP;
+}
+
+static void
+alt_apply (const struct alt_instr *alt)
+{
+  uint8_t *site = (uint8_t *) alt->site;
+  const uint8_t *repl = (const uint8_t *) alt->replacement;
+  int32_t rel;
+
+  alt_copy (site, repl, alt->replacement_len);
+
+  /* Relative to where it was assembled, not to where it is now */
+  if (alt->replacement_len >= 5 &&
+      (repl[0] == ALT_OPCODE_CALL || repl[0] == ALT_OPCODE_JMP))
+  {
+    alt_copy ((uint8_t *) &rel, site + 1, 4);
+    rel += alt->replacement - alt->site;
+    alt_copy (site + 1, (const uint8_t *) &rel, 4);
+  }
+
+  alt_pad (site + alt->replacement_len, alt->site_len - alt->replacement_len);
+}
+
+void
+i386_alternatives_apply (void)
+{
+  const struct alt_instr *alt;
+  uint32_t eax, ebx, ecx, edx;
+
+  for (alt = __start_altinstructions; alt < __stop_altinstructions; ++alt)
+    if (i386_cpu_has (alt->feature))
+      alt_apply (alt);
+
+  /* Serialize, so that no stale prefetched instruction survives */
+  cpuid (CPUID_LEAF_VENDOR, &eax, &ebx, &ecx, &edx);
+}
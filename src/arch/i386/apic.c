@@ -0,0 +1,367 @@
+/*
+ *    apic.c: Local APIC and IO-APIC
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <i386-apic.h>
+#include <i386-cpuid.h>
+#include <i386-int.h>
+#include <i386-io.h>
+#include <i386-kmap.h>
+#include <i386-layout.h>
+#include <i386-msr.h>
+#include <i386-pic.h>
+
+#include <multiboot.h>
+
+/* Interrupt mode configuration register, see MP spec 3.6.2.1 */
+#define IMCR_SELECT      0x22
+#define IMCR_DATA        0x23
+#define IMCR_REGISTER    0x70
+#define IMCR_APIC_MODE   0x01
+
+static struct apic_config apic_config;
+
+static volatile uint32_t *lapic;
+
+static uint8_t apic_bsp_id;
+
+static unsigned long apic_spurious_count;
+
+uint32_t
+i386_lapic_read (uint32_t reg)
+{
+  return lapic[reg >> 2];
+}
+
+void
+i386_lapic_write (uint32_t reg, uint32_t value)
+{
+  lapic[reg >> 2] = value;
+}
+
+/* IO-APIC registers are reached through a select/window pair, and
+   redirection entries are updated read-modify-write: one CPU at a
+   time, whatever the IO-APIC. Held around both helpers below. */
+static spin_t ioapic_lock = SPIN_UNLOCKED;
+
+static uint32_t
+ioapic_read (const struct ioapic *ioapic, uint32_t reg)
+{
+  ioapic->regs[IOAPIC_REG_SELECT >> 2] = reg;
+
+  return ioapic->regs[IOAPIC_REG_WINDOW >> 2];
+}
+
+uint8_t
+i386_lapic_id (void)
+{
+  return i386_lapic_read (LAPIC_REG_ID) >> 24;
+}
+
+void
+i386_lapic_send_ipi (uint8_t apic_id, uint32_t command)
+{
+  uintptr_t flags;
+
+  /* Both halves must be written without anyone sending in between */
+  flags = __arch_irq_save ();
+
+  while (i386_lapic_read (LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING);
+
+  i386_lapic_write (LAPIC_REG_ICR_HIGH, (uint32_t) apic_id << 24);
+  i386_lapic_write (LAPIC_REG_ICR_LOW, command);
+
+  __arch_irq_restore (flags);
+}
+
+void
+i386_lapic_init_cpu (void)
+{
+  if (i386_cpu_has (CPU_FEATURE_MSR))
+    wrmsr (MSR_APIC_BASE, rdmsr (MSR_APIC_BASE) | MSR_APIC_BASE_ENABLE);
+
+  /* ExtINT from the 8259 is no longer wanted through LINT0 */
+  i386_lapic_write (LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+  i386_lapic_write (LAPIC_REG_TPR, 0);
+  i386_lapic_write (LAPIC_REG_SVR, LAPIC_SVR_ENABLE | INT_VECTOR_SPURIOUS);
+}
+
+static void
+ioapic_write (const struct ioapic *ioapic, uint32_t reg, uint32_t value)
+{
+  ioapic->regs[IOAPIC_REG_SELECT >> 2] = reg;
+  ioapic->regs[IOAPIC_REG_WINDOW >> 2] = value;
+}
+
+void
+i386_apic_config_add_cpu (struct apic_config *config, uint8_t apic_id)
+{
+  if (config->cpu_count < CPU_MAX)
+    config->cpu_apic_ids[config->cpu_count++] = apic_id;
+}
+
+void
+i386_apic_config_set_isa_irq (struct apic_config *config,
+                              unsigned int irq,
+                              uint32_t gsi,
+                              uint16_t flags)
+{
+  if (gsi < IRQ_COUNT && gsi != irq && config->isa_gsi[gsi] == gsi)
+    config->isa_gsi[gsi] = APIC_GSI_NONE;
+
+  config->isa_gsi[irq]   = gsi;
+  config->isa_flags[irq] = flags;
+}
+
+int
+i386_apic_config_add_ioapic (struct apic_config *config,
+                             uint8_t id,
+                             uint32_t phys,
+                             uint32_t gsi_base)
+{
+  struct ioapic *ioapic;
+  struct ioapic *prev;
+  uintptr_t lock_flags;
+
+  if (config->ioapic_count == APIC_MAX_IOAPICS)
+    return -1;
+
+  ioapic = &config->ioapics[config->ioapic_count];
+
+  if ((ioapic->regs = i386_ioremap (phys, PAGE_SIZE)) == NULL)
+    return -1;
+
+  ioapic->id   = id;
+
+  lock_flags = spin_lock_irqsave (&ioapic_lock);
+
+  ioapic->pins = ((ioapic_read (ioapic, IOAPIC_VERSION) >> 16) & 0xff) + 1;
+
+  spin_unlock_irqrestore (&ioapic_lock, lock_flags);
+
+  if (gsi_base == APIC_GSI_AUTO)
+  {
+    if (config->ioapic_count > 0)
+    {
+      prev = ioapic - 1;
+      gsi_base = prev->gsi_base + prev->pins;
+    }
+    else
+      gsi_base = 0;
+  }
+
+  ioapic->gsi_base = gsi_base;
+
+  ++config->ioapic_count;
+
+  return 0;
+}
+
+static struct ioapic *
+apic_ioapic_of (uint32_t gsi, unsigned int *pin)
+{
+  struct ioapic *ioapic;
+  unsigned int i;
+
+  for (i = 0; i < apic_config.ioapic_count; ++i)
+  {
+    ioapic = &apic_config.ioapics[i];
+
+    if (gsi >= ioapic->gsi_base && gsi < ioapic->gsi_base + ioapic->pins)
+    {
+      *pin = gsi - ioapic->gsi_base;
+
+      return ioapic;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+apic_set_masked (unsigned int irq, int masked)
+{
+  struct ioapic *ioapic;
+  unsigned int pin;
+  uintptr_t flags;
+  uint32_t rte;
+
+  if (apic_config.isa_gsi[irq] == APIC_GSI_NONE ||
+      (ioapic = apic_ioapic_of (apic_config.isa_gsi[irq], &pin)) == NULL)
+    return;
+
+  flags = spin_lock_irqsave (&ioapic_lock);
+
+  rte = ioapic_read (ioapic, IOAPIC_REDIRECTION (pin));
+
+  if (masked)
+    rte |= IOAPIC_RTE_MASKED;
+  else
+    rte &= ~IOAPIC_RTE_MASKED;
+
+  ioapic_write (ioapic, IOAPIC_REDIRECTION (pin), rte);
+
+  spin_unlock_irqrestore (&ioapic_lock, flags);
+}
+
+static void
+apic_mask (unsigned int irq)
+{
+  apic_set_masked (irq, 1);
+}
+
+static void
+apic_unmask (unsigned int irq)
+{
+  apic_set_masked (irq, 0);
+}
+
+/* A single register write, whatever the IRQ. Level-triggered lines are
+   acknowledged to their IO-APIC by the local APIC itself. */
+static void
+apic_eoi (unsigned int irq)
+{
+  lapic[LAPIC_REG_EOI >> 2] = 0;
+}
+
+const struct irq_controller i386_apic =
+{
+  .name     = "APIC",
+  .mask     = apic_mask,
+  .unmask   = apic_unmask,
+  .eoi      = apic_eoi,
+  .spurious = NULL /* They arrive at their own vector */
+};
+
+/* Raised when an interrupt went away before the CPU accepted it. It is
+   not in service, so it must not be acknowledged. */
+static void
+apic_spurious (struct x86_stack_frame *frame, void *data)
+{
+  ++apic_spurious_count;
+}
+
+/* ISA IRQ N is delivered at vector INT_VECTOR_IRQ_BASE + N, like with
+   the 8259, wherever the firmware says it is wired */
+static void
+apic_route_isa_irqs (void)
+{
+  struct ioapic *ioapic;
+  unsigned int irq;
+  unsigned int pin;
+  uintptr_t lock_flags;
+  uint16_t flags;
+  uint32_t rte;
+
+  for (irq = 0; irq < IRQ_COUNT; ++irq)
+  {
+    if (apic_config.isa_gsi[irq] == APIC_GSI_NONE ||
+        (ioapic = apic_ioapic_of (apic_config.isa_gsi[irq], &pin)) == NULL)
+      continue;
+
+    flags = apic_config.isa_flags[irq];
+    rte   = (INT_VECTOR_IRQ_BASE + irq) | IOAPIC_RTE_MASKED;
+
+    if ((flags & INTI_POLARITY_MASK) == INTI_POLARITY_LOW)
+      rte |= IOAPIC_RTE_POLARITY_LOW;
+
+    if ((flags & INTI_TRIGGER_MASK) == INTI_TRIGGER_LEVEL)
+      rte |= IOAPIC_RTE_LEVEL;
+
+    lock_flags = spin_lock_irqsave (&ioapic_lock);
+
+    ioapic_write (ioapic, IOAPIC_REDIRECTION (pin) + 1, apic_bsp_id << 24);
+    ioapic_write (ioapic, IOAPIC_REDIRECTION (pin), rte);
+
+    spin_unlock_irqrestore (&ioapic_lock, lock_flags);
+  }
+}
+
+int
+i386_apic_enabled (void)
+{
+  return lapic != NULL;
+}
+
+const struct apic_config *
+i386_apic_config (void)
+{
+  return &apic_config;
+}
+
+int
+i386_apic_init (void)
+{
+  const char *option;
+  unsigned int i;
+
+  if ((option = kernel_command_line_option ("apic")) != NULL &&
+      strncmp (option, "off", 3) == 0)
+    return -1;
+
+  if (!i386_cpu_has (CPU_FEATURE_APIC))
+    return -1;
+
+  for (i = 0; i < IRQ_COUNT; ++i)
+    apic_config.isa_gsi[i] = i;
+
+  apic_config.lapic_phys = LAPIC_DEFAULT_BASE;
+  apic_config.has_8259   = 1;
+
+  if (i386_acpi_parse_madt (&apic_config) != 0 &&
+      i386_mptable_parse (&apic_config) != 0)
+    return -1;
+
+  if (apic_config.ioapic_count == 0)
+    return -1;
+
+  if ((lapic = i386_ioremap (apic_config.lapic_phys, PAGE_SIZE)) == NULL)
+    return -1;
+
+  if (apic_config.has_imcr)
+  {
+    outportb (IMCR_SELECT, IMCR_REGISTER);
+    outportb (IMCR_DATA, IMCR_APIC_MODE);
+  }
+
+  if (apic_config.has_8259)
+    i386_pic_disable ();
+
+  apic_bsp_id = i386_lapic_id ();
+
+  (void) i386_int_register (INT_VECTOR_SPURIOUS, apic_spurious, NULL);
+
+  i386_lapic_init_cpu ();
+
+  apic_route_isa_irqs ();
+
+  printf ("APIC: local APIC %u at 0x%08x, %u CPU(s), %u IO-APIC(s)\n",
+          apic_bsp_id,
+          apic_config.lapic_phys,
+          apic_config.cpu_count,
+          apic_config.ioapic_count);
+
+  return 0;
+}
@@ -16,25 +16,141 @@
  *    along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 
+#include <atomik/atomik.h>
 #include <arch.h>
 
+#include <stdio.h>
+
+#include <i386-alternative.h>
+#include <i386-bootprof.h>
+#include <i386-cpuid.h>
+#include <i386-fpu.h>
+#include <i386-int.h>
+#include <i386-irq.h>
+#include <i386-percpu.h>
+#include <i386-physmem.h>
+#include <i386-regs.h>
+#include <i386-seg.h>
 #include <i386-serial.h>
+#include <i386-syscall.h>
+#include <i386-tsc.h>
+
+#include <multiboot.h>
 
 void
 __arch_machine_halt (void)
 {
+  /* Whatever is still buffered may be the reason we are halting */
+  fflush (NULL);
+
+  i386_serial_flush ();
+
   for (;;)
     __asm__ __volatile__ ("hlt");
 }
 
+const char *
+__arch_boot_option (const char *name)
+{
+  return kernel_command_line_option (name);
+}
+
+uint64_t
+__arch_cycles (void)
+{
+  uint64_t tsc;
+
+  __asm__ __volatile__ ("rdtsc" : "=A" (tsc));
+
+  return tsc;
+}
+
+uint32_t
+__arch_cycles_khz (void)
+{
+  return i386_tsc_khz ();
+}
+
+unsigned int
+__arch_cpu_id (void)
+{
+  return i386_this_cpu_id ();
+}
+
+uintptr_t
+__arch_irq_save (void)
+{
+  uintptr_t flags;
+
+  __asm__ __volatile__ ("pushfl\n"
+                        "popl %0\n"
+                        "cli" : "=r" (flags) :: "memory");
+
+  return flags;
+}
+
+void
+__arch_irq_restore (uintptr_t flags)
+{
+  if (flags & EFLAGS_INTERRUPT)
+    __asm__ __volatile__ ("sti" ::: "memory");
+}
+
+void
+__arch_irq_enable (void)
+{
+  __asm__ __volatile__ ("sti" ::: "memory");
+}
+
+void
+__arch_idle (void)
+{
+  /* STI only takes effect after HLT, so nothing can slip in between */
+  __asm__ __volatile__ ("sti\n"
+                        "hlt" ::: "memory");
+}
+
 void
 __arch_debug_putchar (uint8_t c)
 {
   (void) i386_serial_putchar (0, c);
 }
 
+void
+__arch_debug_write (const void *buf, size_t size)
+{
+  (void) i386_serial_write (0, buf, size);
+}
+
 void
 machine_init (void)
 {
+  /* First of all: __arch_cpu_id () works from here on */
+  i386_gdt_init (0);
+
+  i386_cpu_init ();
+
+  i386_alternatives_apply ();
+
+  i386_idt_init ();
+
+  i386_fpu_init ();
+
   i386_serial_init ();
+
+  BOOT_MARK ("serial_init");
+
+  i386_cpu_dump ();
+
+  i386_irq_init ();
+
+  i386_serial_irq_init ();
+
+  i386_syscall_init ();
+
+  i386_physmem_dump ();
+
+  BOOT_MARK ("physmem_dump");
+
+  __asm__ __volatile__ ("sti" ::: "memory");
 }
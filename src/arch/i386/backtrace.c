@@ -0,0 +1,86 @@
+/*
+ *    backtrace.c: Frame pointer stack walking
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stddef.h>
+
+#include <i386-backtrace.h>
+#include <i386-int.h>
+#include <i386-regs.h>
+
+/* Frames are never this large: a bigger step means EBP is not a frame
+   pointer (yet, or anymore) */
+#define BACKTRACE_MAX_FRAME 0x10000
+
+extern char text_start[];
+extern char text_end[];
+
+struct x86_call_frame
+{
+  struct x86_call_frame *ebp;
+  uint32_t               eip;
+};
+
+static inline int
+backtrace_is_text (uint32_t addr)
+{
+  return addr >= (uint32_t) text_start && addr < (uint32_t) text_end;
+}
+
+unsigned int
+i386_backtrace (uint32_t ebp, uintptr_t *pcs, unsigned int max)
+{
+  struct x86_call_frame *frame = (struct x86_call_frame *) ebp;
+  unsigned int n = 0;
+
+  while (n < max && frame != NULL && ((uintptr_t) frame & 3) == 0)
+  {
+    if (!backtrace_is_text (frame->eip))
+      break;
+
+    pcs[n++] = frame->eip;
+
+    /* Outer frames live higher up the stack */
+    if ((uintptr_t) frame->ebp <= (uintptr_t) frame ||
+        (uintptr_t) frame->ebp - (uintptr_t) frame > BACKTRACE_MAX_FRAME)
+      break;
+
+    frame = frame->ebp;
+  }
+
+  return n;
+}
+
+unsigned int
+__arch_irq_backtrace (uintptr_t *pcs, unsigned int max)
+{
+  struct x86_stack_frame *frame;
+
+  if (max == 0 || (frame = i386_int_current_frame ()) == NULL)
+    return 0;
+
+  pcs[0] = frame->priv.eip;
+
+  /* Userland stacks are not ours to walk */
+  if (X86_FRAME_FROM_USER (frame))
+    return 1;
+
+  return 1 + i386_backtrace (frame->regs.ebp, pcs + 1, max - 1);
+}
@@ -0,0 +1,545 @@
+/*
+ *    bench.c: Arch benchmarks
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <i386-apic.h>
+#include <i386-int.h>
+#include <i386-io.h>
+#include <i386-kmap.h>
+#include <i386-layout.h>
+#include <i386-page.h>
+#include <i386-regs.h>
+#include <i386-seg.h>
+#include <i386-syscall.h>
+
+/* Interrupts raised per measure */
+#define BENCH_INT_COUNT 100000
+
+/* System calls per measure */
+#define BENCH_SYSCALL_COUNT 100000
+
+/* TLB benchmark: kernel pages touched after each CR3 reload, and
+   rounds per measure */
+#define BENCH_TLB_PAGES     64
+#define BENCH_TLB_ROUNDS    10000
+
+/* IRQ samples taken */
+#define BENCH_IRQ_COUNT 1000
+
+/* CMOS RTC, whose periodic interrupt is the IRQ source */
+#define RTC_IRQ             8
+#define RTC_PORT_INDEX      0x70
+#define RTC_PORT_DATA       0x71
+#define RTC_NMI_DISABLE     0x80
+#define RTC_REG_A           0x0a
+#define RTC_REG_B           0x0b
+#define RTC_REG_C           0x0c
+#define RTC_A_RATE_MASK     0x0f
+#define RTC_A_RATE_8192HZ   0x03
+#define RTC_B_PIE           0x40
+#define RTC_PERIODIC_HZ     8192
+
+/* User code runs from the directory slot right below the kmap window,
+   which nothing else uses. Mapped only while a benchmark needs it. */
+#define BENCH_USER_BASE     (KMAP_BASE - PAGE_LARGE_SIZE)
+
+/* See bench-i386.S */
+extern char i386_bench_user_code[];
+extern char i386_bench_user_code_end[];
+extern char i386_bench_int80_code[];
+extern char i386_bench_int80_code_end[];
+extern char i386_bench_sysenter_code[];
+extern char i386_bench_sysenter_code_end[];
+
+/* See kernel.lds */
+extern char text_start[];
+extern int  kernel_end;
+
+void i386_bench_iret (void);
+void i386_bench_user_exit (void);
+void i386_bench_user_enter (uintptr_t, uintptr_t, uint32_t, uint32_t *);
+
+/* Where i386_bench_user_exit finds i386_bench_user_enter's frame */
+uint32_t i386_bench_kernel_esp;
+
+static uint8_t bench_user_page[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+static uint32_t bench_user_table[PAGE_SIZE / sizeof (uint32_t)]
+  __attribute__ ((aligned (PAGE_SIZE)));
+
+static int bench_int_ready;
+
+static uint32_t *
+bench_user_pde (void)
+{
+  uint32_t *page_dir;
+
+  GET_REGISTER ("%cr3", page_dir);
+
+  page_dir = (uint32_t *) PHYS_TO_VIRT (page_dir);
+
+  return &page_dir[BENCH_USER_BASE >> PAGE_LARGE_BITS];
+}
+
+/* Copy SIZE bytes of CODE to the user page and map it at
+   BENCH_USER_BASE, through a page table of its own: the kernel's
+   directory entries stay supervisor-only. Returns NULL if the slot is
+   taken. */
+static uint8_t *
+bench_user_map (const void *code, size_t size)
+{
+  uint32_t *pde = bench_user_pde ();
+
+  if (*pde & PAGE_FLAG_PRESENT)
+    return NULL;
+
+  memcpy (bench_user_page, code, size);
+
+  memset (bench_user_table, 0, sizeof (bench_user_table));
+
+  bench_user_table[0] = ((uint32_t) bench_user_page - KERNEL_BASE)
+    | PAGE_TABLE_DFL_FLAGS | PAGE_FLAG_USERLAND;
+
+  *pde = ((uint32_t) bench_user_table - KERNEL_BASE)
+    | PAGE_TABLE_DFL_FLAGS | PAGE_FLAG_USERLAND;
+
+  return (uint8_t *) BENCH_USER_BASE;
+}
+
+static void
+bench_user_unmap (void)
+{
+  *bench_user_pde () = 0;
+
+  bench_user_table[0] = 0;
+
+  __asm__ __volatile__ ("invlpg (%0)" :: "r" (BENCH_USER_BASE) : "memory");
+}
+
+static void
+bench_int_nop (struct x86_stack_frame *frame, void *data)
+{
+}
+
+static void
+bench_int_setup (void)
+{
+  if (bench_int_ready)
+    return;
+
+  bench_int_ready = 1;
+
+  i386_int_set_raw (INT_VECTOR_BENCH_BARE, i386_bench_iret);
+  i386_int_set_raw (INT_VECTOR_BENCH_EXIT, i386_bench_user_exit);
+
+  (void) i386_int_register (INT_VECTOR_BENCH, bench_int_nop, NULL);
+
+  i386_int_set_user (INT_VECTOR_BENCH_BARE);
+  i386_int_set_user (INT_VECTOR_BENCH);
+  i386_int_set_user (INT_VECTOR_BENCH_EXIT);
+}
+
+/* From the kernel: the reduced frame (see isr-i386.S) */
+static uint64_t
+bench_int_kernel (int bare)
+{
+  uintptr_t flags;
+  uint64_t cycles;
+  unsigned int i;
+
+  flags = __arch_irq_save ();
+
+  cycles = __arch_cycles ();
+
+  if (bare)
+    for (i = 0; i < BENCH_INT_COUNT; ++i)
+      __asm__ __volatile__ ("int %0" :: "i" (INT_VECTOR_BENCH_BARE) : "memory");
+  else
+    for (i = 0; i < BENCH_INT_COUNT; ++i)
+      __asm__ __volatile__ ("int %0" :: "i" (INT_VECTOR_BENCH) : "memory");
+
+  cycles = __arch_cycles () - cycles;
+
+  __arch_irq_restore (flags);
+
+  return cycles / BENCH_INT_COUNT;
+}
+
+/* From userland: the full frame. Includes a single return to userland
+   and back, which is lost in the count. The top of our stack is in use,
+   so i386_bench_user_enter points esp0 below its frame. Interrupts stay
+   disabled meanwhile: we cannot be switched out, and nobody else sees
+   that esp0 before it is restored. */
+static uint64_t
+bench_int_user (uint8_t *user, unsigned int vector)
+{
+  uint32_t *esp0;
+  uint32_t saved;
+  uintptr_t flags;
+  uint64_t cycles;
+
+  bench_user_page[1] = vector;
+
+  flags = __arch_irq_save ();
+
+  esp0  = i386_tss_kernel_stack_slot ();
+  saved = *esp0;
+
+  cycles = __arch_cycles ();
+
+  i386_bench_user_enter (
+    (uintptr_t) user,
+    (uintptr_t) user + PAGE_SIZE,
+    BENCH_INT_COUNT,
+    esp0);
+
+  cycles = __arch_cycles () - cycles;
+
+  *esp0 = saved;
+
+  __arch_irq_restore (flags);
+
+  return cycles / BENCH_INT_COUNT;
+}
+
+void
+__arch_bench_int (void)
+{
+  uint64_t kernel_bare, kernel_full, user_bare, user_full;
+  uint8_t *user;
+
+  if ((user = bench_user_map (
+         i386_bench_user_code,
+         i386_bench_user_code_end - i386_bench_user_code)) == NULL)
+  {
+    printf ("bench: cannot map user page\n");
+    return;
+  }
+
+  bench_int_setup ();
+
+  kernel_bare = bench_int_kernel (1);
+  kernel_full = bench_int_kernel (0);
+  user_bare   = bench_int_user (user, INT_VECTOR_BENCH_BARE);
+  user_full   = bench_int_user (user, INT_VECTOR_BENCH);
+
+  bench_user_unmap ();
+
+  /* Bare: the gate just returns. Dispatched: entry stub, common path,
+     i386_int_dispatch and an empty handler. */
+  printf ("Interrupt entry and exit (cycles per INT, %u each):\n",
+          BENCH_INT_COUNT);
+  printf ("  %-10s %10s %10s\n", "from", "bare", "dispatched");
+  printf ("  %-10s %10llu %10llu\n", "kernel", kernel_bare, kernel_full);
+  printf ("  %-10s %10llu %10llu\n", "userland", user_bare, user_full);
+}
+
+static uint8_t
+bench_rtc_read (uint8_t reg)
+{
+  outportb (RTC_PORT_INDEX, RTC_NMI_DISABLE | reg);
+  return inportb (RTC_PORT_DATA);
+}
+
+static void
+bench_rtc_write (uint8_t reg, uint8_t value)
+{
+  outportb (RTC_PORT_INDEX, RTC_NMI_DISABLE | reg);
+  outportb (RTC_PORT_DATA, value);
+}
+
+static int bench_irq_attached;
+
+/* Cycle counts taken by the handler, 0 if it did not run */
+static volatile uint64_t bench_irq_entry;
+static volatile uint64_t bench_irq_leave;
+
+static void
+bench_irq_handler (unsigned int irq, void *data)
+{
+  bench_irq_entry = __arch_cycles ();
+
+  /* Reading C lowers the line and lets the next period raise it */
+  (void) bench_rtc_read (RTC_REG_C);
+
+  bench_irq_leave = __arch_cycles ();
+}
+
+void
+__arch_bench_irq (void)
+{
+  uint64_t entry_sum = 0, leave_sum = 0, entry_min = -1, leave_min = -1;
+  uint64_t t0, t1, wait, period;
+  unsigned int i, samples = 0;
+  uint8_t reg_a, reg_b;
+  uintptr_t flags;
+
+  if (__arch_cpu_id () != 0)
+  {
+    printf ("bench: IRQs are only delivered to CPU 0\n");
+    return;
+  }
+
+  if (!bench_irq_attached)
+  {
+    if (__arch_irq_attach (RTC_IRQ, bench_irq_handler, NULL) == -1)
+    {
+      printf ("bench: cannot attach IRQ %u\n", RTC_IRQ);
+      return;
+    }
+
+    bench_irq_attached = 1;
+  }
+  else
+    __arch_irq_unmask (RTC_IRQ);
+
+  period = (uint64_t) __arch_cycles_khz () * 1000 / RTC_PERIODIC_HZ;
+
+  flags = __arch_irq_save ();
+
+  reg_a = bench_rtc_read (RTC_REG_A);
+  reg_b = bench_rtc_read (RTC_REG_B);
+
+  bench_rtc_write (RTC_REG_A, (reg_a & ~RTC_A_RATE_MASK) | RTC_A_RATE_8192HZ);
+  bench_rtc_write (RTC_REG_B, reg_b | RTC_B_PIE);
+  (void) bench_rtc_read (RTC_REG_C);
+
+  for (i = 0; i < BENCH_IRQ_COUNT; ++i)
+  {
+    bench_irq_entry = 0;
+
+    /* Two periods with interrupts off: the IRQ is surely pending */
+    wait = __arch_cycles () + 2 * period;
+    while (__arch_cycles () < wait)
+      ;
+
+    t0 = __arch_cycles ();
+    __asm__ __volatile__ ("sti; nop; cli" ::: "memory");
+    t1 = __arch_cycles ();
+
+    if (bench_irq_entry == 0)
+      continue;
+
+    /* Another pending interrupt may have been taken first: the minimum
+       is the figure to trust */
+    entry_sum += bench_irq_entry - t0;
+    leave_sum += t1 - bench_irq_leave;
+
+    if (bench_irq_entry - t0 < entry_min)
+      entry_min = bench_irq_entry - t0;
+    if (t1 - bench_irq_leave < leave_min)
+      leave_min = t1 - bench_irq_leave;
+
+    ++samples;
+  }
+
+  bench_rtc_write (RTC_REG_B, reg_b);
+  bench_rtc_write (RTC_REG_A, reg_a);
+  (void) bench_rtc_read (RTC_REG_C);
+
+  __arch_irq_mask (RTC_IRQ);
+
+  __arch_irq_restore (flags);
+
+  if (samples == 0)
+  {
+    printf ("bench: IRQ %u never fired\n", RTC_IRQ);
+    return;
+  }
+
+  /* Boot with apic=off to get the 8259 figures */
+  printf ("IRQ delivery through the %s (RTC IRQ %u, cycles, %u samples):\n",
+          i386_apic_enabled () ? "APIC" : "8259",
+          RTC_IRQ,
+          samples);
+  printf ("  %-20s %10s %10s\n", "", "min", "avg");
+  printf ("  %-20s %10llu %10llu\n",
+          "pending to handler", entry_min, entry_sum / samples);
+  printf ("  %-20s %10llu %10llu\n",
+          "handler to return", leave_min, leave_sum / samples);
+}
+
+/* SYS_NULL round trips from the user code at USER. System calls run
+   with interrupts enabled: preemption is kept off instead, so that we
+   stay in place while esp0 points below our frame. */
+static uint64_t
+bench_syscall_user (uint8_t *user)
+{
+  uint32_t *esp0;
+  uint32_t saved;
+  uintptr_t flags;
+  uint64_t cycles;
+
+  flags = __arch_irq_save ();
+
+  i386_int_preempt_disable ();
+
+  esp0  = i386_tss_kernel_stack_slot ();
+  saved = *esp0;
+
+  cycles = __arch_cycles ();
+
+  i386_bench_user_enter (
+    (uintptr_t) user,
+    (uintptr_t) user + PAGE_SIZE,
+    BENCH_SYSCALL_COUNT,
+    esp0);
+
+  cycles = __arch_cycles () - cycles;
+
+  *esp0 = saved;
+
+  i386_int_preempt_enable ();
+
+  __arch_irq_restore (flags);
+
+  return cycles / BENCH_SYSCALL_COUNT;
+}
+
+void
+__arch_bench_syscall (void)
+{
+  uint64_t int80, sysenter = 0;
+  uint8_t *user;
+
+  bench_int_setup ();
+
+  if ((user = bench_user_map (
+         i386_bench_int80_code,
+         i386_bench_int80_code_end - i386_bench_int80_code)) == NULL)
+  {
+    printf ("bench: cannot map user page\n");
+    return;
+  }
+
+  int80 = bench_syscall_user (user);
+
+  bench_user_unmap ();
+
+  if (i386_syscall_sysenter_enabled ())
+  {
+    user = bench_user_map (
+      i386_bench_sysenter_code,
+      i386_bench_sysenter_code_end - i386_bench_sysenter_code);
+
+    sysenter = bench_syscall_user (user);
+
+    bench_user_unmap ();
+  }
+
+  printf ("SYS_NULL round trip from userland (cycles per call, %u each):\n",
+          BENCH_SYSCALL_COUNT);
+  printf ("  %-10s %10llu\n", "INT $0x80", int80);
+
+  if (i386_syscall_sysenter_enabled ())
+    printf ("  %-10s %10llu\n", "SYSENTER", sysenter);
+  else
+    printf ("  %-10s %10s\n", "SYSENTER", "(none)");
+}
+
+/* Cycles per round of touching PAGES kernel pages, one read each,
+   after reloading CR3 if RELOAD is set */
+static uint64_t
+bench_tlb_round (unsigned int pages, int reload)
+{
+  uint64_t cycles = 0, t0;
+  unsigned int i, j;
+  uint32_t cr3;
+
+  GET_REGISTER ("%cr3", cr3);
+
+  for (i = 0; i < BENCH_TLB_ROUNDS; ++i)
+  {
+    t0 = __arch_cycles ();
+
+    if (reload)
+      SET_REGISTER ("%cr3", cr3);
+
+    for (j = 0; j < pages; ++j)
+      (void) *(volatile char *) (text_start + (j << PAGE_BITS));
+
+    cycles += __arch_cycles () - t0;
+  }
+
+  return cycles / BENCH_TLB_ROUNDS;
+}
+
+/* What each page costs on top of a warm TLB, noise aside */
+static uint64_t
+bench_tlb_per_page (uint64_t cycles, uint64_t warm, unsigned int pages)
+{
+  return cycles > warm ? (cycles - warm) / pages : 0;
+}
+
+void
+__arch_bench_tlb (void)
+{
+  uint64_t warm, global = 0, flushed;
+  unsigned int pages;
+  uintptr_t flags;
+  uint32_t cr4;
+
+  pages = ((uintptr_t) &kernel_end + KERNEL_BASE - (uintptr_t) text_start)
+    >> PAGE_BITS;
+
+  if (pages > BENCH_TLB_PAGES)
+    pages = BENCH_TLB_PAGES;
+
+  flags = __arch_irq_save ();
+
+  GET_REGISTER ("%cr4", cr4);
+
+  warm = bench_tlb_round (pages, 0);
+
+  /* Kernel pages are global when PGE is on (see boot_page_flags): a
+     CR3 reload keeps their TLB entries. Clearing PGE flushes them and
+     makes the bit meaningless, as if it had never been set. */
+  if (cr4 & CR4_PGE)
+  {
+    global = bench_tlb_round (pages, 1);
+
+    SET_REGISTER ("%cr4", cr4 & ~CR4_PGE);
+  }
+
+  flushed = bench_tlb_round (pages, 1);
+
+  SET_REGISTER ("%cr4", cr4);
+
+  __arch_irq_restore (flags);
+
+  printf ("Address space switch (CR3 reload, then %u kernel pages read, "
+          "%s pages, cycles):\n",
+          pages,
+          cr4 & CR4_PSE ? "4 MiB" : "4 KiB");
+  printf ("  %-12s %10s %10s\n", "", "per round", "per page");
+  printf ("  %-12s %10llu %10s\n", "no reload", warm, "-");
+
+  if (cr4 & CR4_PGE)
+    printf ("  %-12s %10llu %10llu\n",
+            "PGE on", global, bench_tlb_per_page (global, warm, pages));
+  else
+    printf ("  %-12s %10s %10s\n", "PGE on", "(none)", "-");
+
+  printf ("  %-12s %10llu %10llu\n",
+          "PGE off", flushed, bench_tlb_per_page (flushed, warm, pages));
+}
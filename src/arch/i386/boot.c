@@ -19,9 +19,13 @@
 #include <atomik/atomik.h>
 
 #include <stdlib.h> /* For NULL */
+#include <string.h>
 
+#include <i386-bootprof.h>
+#include <i386-cpuid.h>
 #include <i386-layout.h>
 #include <i386-page.h>
+#include <i386-physmem.h>
 #include <i386-regs.h>
 #include <i386-vga.h>
 
@@ -54,6 +58,7 @@ BOOT_SYMBOL (uint32_t initrd_size) = 0;
 
 BOOT_SYMBOL (char bootstack[4 * PAGE_SIZE]); /* Boot stack, as used by _start */
 BOOT_SYMBOL (char cmdline_copy[128]);
+BOOT_SYMBOL (struct multiboot_info multiboot_info_copy);
 BOOT_SYMBOL (struct multiboot_info *multiboot_info);
 
 /* Inner state of boot_entry */
@@ -62,6 +67,8 @@ BOOT_SYMBOL (static int cur_y) = 0;
 BOOT_SYMBOL (static struct page_table *page_dir);
 BOOT_SYMBOL (static struct page_table *page_table_list);
 BOOT_SYMBOL (static int page_table_count);
+BOOT_SYMBOL (static int boot_pse_enabled) = 0;
+BOOT_SYMBOL (static int boot_pge_enabled) = 0;
 
 /* Some static text. It must be explicitly set up as boot_symbol, otherwise it would be linked inside .rodata (which is at upper half) */
 BOOT_SYMBOL (static char string0[]) = "This is Atomik's boot_entry, v0.1 alpha\n(c) 2014 Gonzalo J. Carracedo <BatchDrake@gmail.com>\n\n";
@@ -75,6 +82,11 @@ BOOT_SYMBOL (static char string6[]) = "\n\nConfiguring inital virtual address sp
 BOOT_SYMBOL (static char string7[]) = "\nMemory configuration done, switching to virtual memory and booting Atomik...\n";
 
 /* Some static functions not needed outside */
+BOOT_FUNCTION (static int  boot_cpuid_supported (void));
+BOOT_FUNCTION (static void boot_cpuid (uint32_t, uint32_t *));
+BOOT_FUNCTION (static void boot_detect_features (void));
+BOOT_FUNCTION (static uint32_t boot_page_flags (uint32_t));
+BOOT_FUNCTION (static struct page_table *boot_get_page_table (uint32_t));
 BOOT_FUNCTION (static void boot_setup_vregion (uint32_t, uint32_t, uint32_t));
 BOOT_FUNCTION (static void boot_outportb (uint16_t, uint8_t));
 BOOT_FUNCTION (static void dword_to_decimal (uint32_t, char *));
@@ -106,6 +118,27 @@ kernel_command_line (void)
     return "";
 }
 
+const char *
+kernel_command_line_option (const char *name)
+{
+  const char *p = kernel_command_line ();
+  size_t len = strlen (name);
+
+  while (*p != '\0')
+  {
+    while (*p == ' ')
+      ++p;
+
+    if (strncmp (p, name, len) == 0 && p[len] == '=')
+      return p + len + 1;
+
+    while (*p != '\0' && *p != ' ')
+      ++p;
+  }
+
+  return NULL;
+}
+
 static void
 boot_outportb (uint16_t port, uint8_t data)
 {
@@ -271,6 +304,67 @@ struct page_table
   uint32_t entries[PAGE_SIZE / sizeof (uint32_t)];
 };
 
+static int
+boot_cpuid_supported (void)
+{
+  uint32_t before, after;
+
+  /* CPUID is there if we are able to toggle the ID flag in EFLAGS */
+  __asm__ __volatile__ ("pushfl\n"
+                        "popl %0\n"
+                        "movl %0, %1\n"
+                        "xorl %2, %1\n"
+                        "pushl %1\n"
+                        "popfl\n"
+                        "pushfl\n"
+                        "popl %1\n"
+                        "pushl %0\n"
+                        "popfl\n"
+                        : "=&r" (before), "=&r" (after)
+                        : "i" (EFLAGS_IDENTIFY));
+
+  return ((before ^ after) & EFLAGS_IDENTIFY) != 0;
+}
+
+static void
+boot_cpuid (uint32_t leaf, uint32_t *regs)
+{
+  __asm__ __volatile__ ("cpuid"
+                        : "=a" (regs[0]), "=b" (regs[1]), "=c" (regs[2]), "=d" (regs[3])
+                        : "a" (leaf), "c" (0));
+}
+
+static void
+boot_detect_features (void)
+{
+  uint32_t regs[4];
+
+  if (!boot_cpuid_supported ())
+    return;
+
+  boot_cpuid (CPUID_LEAF_VENDOR, regs);
+
+  if (regs[0] < CPUID_LEAF_FEATURES)
+    return;
+
+  boot_cpuid (CPUID_LEAF_FEATURES, regs);
+
+  boot_pse_enabled = (regs[3] & CPUID_EDX_PSE) != 0;
+  boot_pge_enabled = (regs[3] & CPUID_EDX_PGE) != 0;
+}
+
+/* Kernel half mappings are the same in every address space: mark them as
+   global so they survive CR3 reloads */
+static uint32_t
+boot_page_flags (uint32_t page_virt)
+{
+  uint32_t flags = PAGE_FLAG_PRESENT | PAGE_FLAG_WRITABLE;
+
+  if (boot_pge_enabled && page_virt >= (KERNEL_BASE >> 12))
+    flags |= PAGE_FLAG_GLOBAL;
+
+  return flags;
+}
 
   
 static void
@@ -290,6 +384,32 @@ boot_print_mmap (uint32_t phys, uint32_t virt, uint32_t pages)
   boot_puts (msg3);
 }
 
+/* Return the page table for a given virtual page, allocating it if
+   necessary. If the directory entry maps a 4 MiB page, it is split into
+   a page table with the same contents. */
+static struct page_table *
+boot_get_page_table (uint32_t page_virt)
+{
+  uint32_t *pde = &page_dir->entries[page_virt >> 10];
+  struct page_table *table;
+  uint32_t i;
+
+  if ((*pde & PAGE_FLAG_PRESENT) && !(*pde & PAGE_FLAG_4MIB_PAGES))
+    return (struct page_table *) (*pde & PAGE_MASK);
+
+  table = page_table_list + page_table_count++;
+
+  for (i = 0; i < PAGE_SIZE / sizeof (uint32_t); ++i)
+    if (*pde & PAGE_FLAG_PRESENT)
+      table->entries[i] = ((*pde & PAGE_LARGE_MASK) + (i << 12)) | (*pde & CONTROL_BITS & ~PAGE_FLAG_4MIB_PAGES);
+    else
+      table->entries[i] = 0;
+
+  *pde = (uint32_t) table | PAGE_FLAG_PRESENT | PAGE_FLAG_WRITABLE;
+
+  return table;
+}
+
 static void
 boot_setup_vregion (uint32_t page_phys_start, uint32_t page_virt_start, uint32_t page_count)
 {
@@ -298,21 +418,33 @@ boot_setup_vregion (uint32_t page_phys_start, uint32_t page_virt_start, uint32_t
   struct page_table *current;
 
   boot_print_mmap (page_phys_start << 12, page_virt_start << 12, page_count);
+
+  j = 0;
   
-  for (j = 0; j < page_count; ++j)
+  while (j < page_count)
   {
     page_phys = j + page_phys_start;
     page_virt = j + page_virt_start;
-    
-    if (!page_dir->entries[page_virt >> 10])
+
+    /* Whole 4 MiB chunk with both addresses aligned: a single directory
+       entry is enough, no page table needed */
+    if (boot_pse_enabled &&
+        !(page_phys & (PAGE_LARGE_PAGES - 1)) &&
+        !(page_virt & (PAGE_LARGE_PAGES - 1)) &&
+        page_count - j >= PAGE_LARGE_PAGES &&
+        !(page_dir->entries[page_virt >> 10] & PAGE_FLAG_PRESENT))
     {
-      current = page_table_list + page_table_count++;
-      page_dir->entries[page_virt >> 10] = (uint32_t) current | PAGE_FLAG_PRESENT | PAGE_FLAG_WRITABLE;
+      page_dir->entries[page_virt >> 10] = (page_phys << 12) | boot_page_flags (page_virt) | PAGE_FLAG_4MIB_PAGES;
+      
+      j += PAGE_LARGE_PAGES;
+      continue;
     }
-    else
-      current = (struct page_table *) (page_dir->entries[page_virt >> 10] & PAGE_MASK);
+
+    current = boot_get_page_table (page_virt);
     
-    current->entries[page_virt & 1023] = (page_phys << 12) | PAGE_FLAG_PRESENT | PAGE_FLAG_WRITABLE;
+    current->entries[page_virt & 1023] = (page_phys << 12) | boot_page_flags (page_virt);
+
+    ++j;
   }
 }
 
@@ -322,36 +454,49 @@ boot_prepare_paging_early (void)
   uint32_t free_mem = __ALIGN ((uint32_t) &kernel_end, PAGE_SIZE);
   
   struct multiboot_info *mbi;
-  struct memory_map *mmap_info;
+  const struct memory_region *regions;
+  unsigned int region_count;
     
-  uint32_t page_count;
-  uint32_t page_phys_start;
-  uint32_t page_virt_start;
+  uint64_t region_start;
+  uint64_t region_end;
+
+  uint32_t kernel_phys;
+  uint32_t kernel_virt;
+  uint32_t kernel_top;
   
   uint32_t i;
-  uint32_t mmap_count;
   char errmsg[] = "No memory maps in MBI!";
 
   struct module *mod;
   
   mbi = multiboot_location ();
 
+  boot_detect_features ();
+
   if (!(mbi->flags & (1 << 6)))
   {
     boot_puts (errmsg);
     boot_halt ();
   }
 
+  /* Page tables go after the kernel, past any module the loader may
+     have put there */
+  mod = (struct module *) mbi->mods_addr;
+
   if (mbi->mods_count)
   {
-    mod = (struct module *) mbi->mods_addr;
-    
     initrd_phys  = (void *) mod->mod_start;
     initrd_size  = mod->mod_end - mod->mod_start;
 
-    if (mod->mod_end > free_mem)
-      free_mem = __ALIGN (mod->mod_end, PAGE_SIZE);
+    if ((uint32_t) &mod[mbi->mods_count] > free_mem)
+      free_mem = __ALIGN ((uint32_t) &mod[mbi->mods_count], PAGE_SIZE);
   }
+
+  for (i = 0; i < mbi->mods_count; ++i)
+    if (mod[i].mod_end > free_mem)
+      free_mem = __ALIGN (mod[i].mod_end, PAGE_SIZE);
+
+  boot_memory_regions_init (mbi);
   
   page_dir = (struct page_table *) free_mem;
   page_table_list = page_dir + 1;
@@ -360,10 +505,21 @@ boot_prepare_paging_early (void)
   for (i = 0; i < PAGE_SIZE / sizeof (uint32_t); ++i)
     page_dir->entries[i] = 0;
 
-  mmap_count = mbi->mmap_length / sizeof (memory_map_t);
+  /* Map microkernel to upperhalf. With large pages, the region is widened
+     to 4 MiB boundaries (the linker script keeps both addresses congruent)
+     so the whole image fits in a few directory entries */
+  kernel_phys = (uint32_t) &kernel_start;
+  kernel_virt = (uint32_t) &text_start;
+  kernel_top  = free_mem;
+
+  if (boot_pse_enabled && !((kernel_phys ^ kernel_virt) & ~PAGE_LARGE_MASK))
+  {
+    kernel_virt -= kernel_phys & ~PAGE_LARGE_MASK;
+    kernel_phys &= PAGE_LARGE_MASK;
+    kernel_top   = __ALIGN (kernel_top, PAGE_LARGE_SIZE);
+  }
   
-  /* Map microkernel to upperhalf */
-  boot_setup_vregion ((uint32_t) &kernel_start >> 12, (uint32_t) &text_start >> 12, __UNITS (free_mem - (uint32_t) &kernel_start, PAGE_SIZE));
+  boot_setup_vregion (kernel_phys >> 12, kernel_virt >> 12, __UNITS (kernel_top - kernel_phys, PAGE_SIZE));
 
   /* Map video memory */
   boot_setup_vregion ((uint32_t) VIDEO_BASE >> 12, (uint32_t) VIDEO_BASE >> 12, 1);
@@ -372,21 +528,50 @@ boot_prepare_paging_early (void)
   if (initrd_size > 0)
     initrd_start = (void *) ((uint32_t) initrd_phys + PAGE_START ((uint32_t) &text_start) - PAGE_START ((uint32_t) &kernel_start));
   
-  for (i = 0; i < mmap_count; ++i)
-  {    
-    mmap_info = (struct memory_map *) (mbi->mmap_addr + i * sizeof (memory_map_t));
+  /* Identity-map RAM below the kernel. Firmware areas and holes are left
+     out, and contiguous regions are mapped at once so large pages can
+     span region boundaries */
+  regions = boot_memory_region_table (&region_count);
+  
+  i = 0;
+  
+  while (i < region_count)
+  {
+    if (!MEMORY_REGION_MAPPED (regions[i].type))
+    {
+      ++i;
+      continue;
+    }
 
-    page_count = __UNITS (mmap_info->length_low, PAGE_SIZE);
-    
-    page_phys_start = mmap_info->base_addr_low >> 12;
-    page_virt_start = page_phys_start;
+    region_start = regions[i].start;
+    region_end   = regions[i].end;
 
-    boot_setup_vregion (page_phys_start, page_virt_start, page_count);
+    while (++i < region_count &&
+           MEMORY_REGION_MAPPED (regions[i].type) &&
+           regions[i].start == region_end)
+      region_end = regions[i].end;
+
+    if (region_start >= KERNEL_BASE)
+      continue;
+
+    if (region_end > KERNEL_BASE)
+      region_end = KERNEL_BASE;
+
+    boot_setup_vregion (
+      (uint32_t) region_start >> 12,
+      (uint32_t) region_start >> 12,
+      __UNITS ((uint32_t) region_end, PAGE_SIZE) - ((uint32_t) region_start >> 12));
   }
 
   __free_start = (uint32_t) &page_table_list[page_table_count];
+
+  /* Boot page tables are part of the kernel from now on */
+  boot_memory_region_add (free_mem, __free_start, MEMORY_REGION_KERNEL);
 }
 
+/* The multiboot information may be anywhere in memory, and the
+   command line is read long after the frame allocator has taken over:
+   keep what we need inside the kernel image */
 void
 boot_fix_multiboot (void)
 {
@@ -397,6 +582,8 @@ boot_fix_multiboot (void)
 
   mbi = multiboot_location ();
 
+  multiboot_info_copy = *mbi;
+
   if (mbi->flags & (1 << 2))
   {
     p = (char *) mbi->cmdline;
@@ -407,16 +594,23 @@ boot_fix_multiboot (void)
 
     cmdline_copy[i] = '\0';
 
-    mbi->cmdline = (unsigned long) cmdline_copy;
+    multiboot_info_copy.cmdline = (unsigned long) cmdline_copy;
   }
+
+  multiboot_info = &multiboot_info_copy;
 }
 
 void
 boot_entry (void)
 {
   uint32_t cr0;
+  uint32_t cr4;
+
+  BOOT_MARK ("entry");
   
   boot_screen_clear (BOOTTIME_DEFAULT_ATTRIBUTE);
+
+  BOOT_MARK ("screen_clear");
   
   boot_puts (string0);
   
@@ -431,12 +625,31 @@ boot_entry (void)
   boot_print_hex ((uint32_t) &text_start);
   boot_puts (string6);
 
-  boot_prepare_paging_early ();
+  BOOT_MARK ("banner");
 
+  /* Before the page tables are written: they may land on the MBI */
   boot_fix_multiboot ();
+
+  boot_prepare_paging_early ();
+
+  BOOT_MARK ("page_tables");
   
   boot_puts (string7);
   
+  /* Large and global pages must be on before the first CR3 load */
+  if (boot_pse_enabled || boot_pge_enabled)
+  {
+    GET_REGISTER ("%cr4", cr4);
+
+    if (boot_pse_enabled)
+      cr4 |= CR4_PSE;
+
+    if (boot_pge_enabled)
+      cr4 |= CR4_PGE;
+
+    SET_REGISTER ("%cr4", cr4);
+  }
+  
   SET_REGISTER ("%cr3", page_dir);
   
   GET_REGISTER ("%cr0", cr0);
@@ -445,7 +658,11 @@ boot_entry (void)
   
   SET_REGISTER ("%cr0", cr0);
 
+  BOOT_MARK ("paging_on");
+
   boot_screen_clear (0x07);
+
+  BOOT_MARK ("screen_clear2");
   
   main ();
 }
@@ -0,0 +1,68 @@
+/*
+ *    bootprof.c: Boot phase profiling
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+
+#include <i386-bootprof.h>
+#include <i386-tsc.h>
+
+BOOT_SYMBOL (struct boot_mark boot_marks[BOOT_MARK_MAX]);
+BOOT_SYMBOL (unsigned int boot_mark_count) = 0;
+
+void
+__arch_boot_mark (const char *phase)
+{
+  BOOT_MARK (phase);
+}
+
+void
+__arch_boot_report (void)
+{
+  uint32_t khz;
+  uint64_t cycles;
+  unsigned int i;
+
+  if (boot_mark_count < 2)
+    return;
+
+  khz = i386_tsc_khz ();
+
+  printf ("Boot profile (TSC at %u kHz):\n", khz);
+  printf ("  %-16s %14s %10s\n", "phase", "cycles", "us");
+
+  for (i = 1; i < boot_mark_count; ++i)
+  {
+    cycles = boot_marks[i].tsc - boot_marks[i - 1].tsc;
+
+    printf (
+      "  %-16s %14llu %10llu\n",
+      boot_marks[i].phase,
+      cycles,
+      khz ? cycles * 1000 / khz : 0);
+  }
+
+  cycles = boot_marks[boot_mark_count - 1].tsc - boot_marks[0].tsc;
+
+  printf (
+    "Boot profile: total %llu cycles (%llu us)\n",
+    cycles,
+    khz ? cycles * 1000 / khz : 0);
+}
@@ -0,0 +1,63 @@
+/*
+ *    context.c: Kernel thread contexts
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <i386-seg.h>
+
+extern char context_start[];
+
+/* Initial stack, from the top down: ARG, ENTRY, the return address of
+   __arch_context_switch (context_start) and the callee-saved registers
+   it pops */
+struct context_frame
+{
+  uint32_t edi;
+  uint32_t esi;
+  uint32_t ebx;
+  uint32_t ebp;
+  uint32_t eip;
+  uint32_t entry;
+  uint32_t arg;
+};
+
+uintptr_t
+__arch_context_init (void *stack, size_t size, void (*entry) (void *), void *arg)
+{
+  struct context_frame *frame;
+  uintptr_t top = ((uintptr_t) stack + size) & ~15;
+
+  frame = (struct context_frame *) top - 1;
+
+  frame->edi   = 0;
+  frame->esi   = 0;
+  frame->ebx   = 0;
+  frame->ebp   = 0;
+  frame->eip   = (uint32_t) context_start;
+  frame->entry = (uint32_t) entry;
+  frame->arg   = (uint32_t) arg;
+
+  return (uintptr_t) frame;
+}
+
+void
+__arch_set_kernel_stack (uintptr_t top)
+{
+  i386_tss_set_kernel_stack (top);
+}
@@ -0,0 +1,285 @@
+/*
+ *    cpuid.c: CPU identification and feature detection
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <i386-cpuid.h>
+#include <i386-regs.h>
+
+static struct cpu_features cpu_features;
+
+static const struct
+{
+  unsigned int feature;
+  const char  *name;
+}
+cpu_feature_names[] =
+{
+  {CPU_FEATURE_PSE,           "pse"},
+  {CPU_FEATURE_PGE,           "pge"},
+  {CPU_FEATURE_PAE,           "pae"},
+  {CPU_FEATURE_NX,            "nx"},
+  {CPU_FEATURE_APIC,          "apic"},
+  {CPU_FEATURE_X2APIC,        "x2apic"},
+  {CPU_FEATURE_SEP,           "sep"},
+  {CPU_FEATURE_CMOV,          "cmov"},
+  {CPU_FEATURE_FXSR,          "fxsr"},
+  {CPU_FEATURE_SSE,           "sse"},
+  {CPU_FEATURE_SSE2,          "sse2"},
+  {CPU_FEATURE_SSE3,          "sse3"},
+  {CPU_FEATURE_SSE4_2,        "sse4.2"},
+  {CPU_FEATURE_AVX,           "avx"},
+  {CPU_FEATURE_ERMS,          "erms"},
+  {CPU_FEATURE_TSC_DEADLINE,  "tsc-deadline"},
+  {CPU_FEATURE_INVARIANT_TSC, "invariant-tsc"},
+  {CPU_FEATURE_HYPERVISOR,    "hypervisor"}
+};
+
+/* Same test as boot_cpuid_supported: 386 and early 486 lack CPUID */
+static int
+cpu_has_cpuid (void)
+{
+  uint32_t before, after;
+
+  __asm__ __volatile__ ("pushfl\n"
+                        "popl %0\n"
+                        "movl %0, %1\n"
+                        "xorl %2, %1\n"
+                        "pushl %1\n"
+                        "popfl\n"
+                        "pushfl\n"
+                        "popl %1\n"
+                        "pushl %0\n"
+                        "popfl\n"
+                        : "=&r" (before), "=&r" (after)
+                        : "i" (EFLAGS_IDENTIFY));
+
+  return ((before ^ after) & EFLAGS_IDENTIFY) != 0;
+}
+
+static void
+cpu_detect_identity (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint32_t brand[4];
+  unsigned int i;
+
+  cpuid (CPUID_LEAF_VENDOR, &eax, &ebx, &ecx, &edx);
+
+  cpu_features.max_leaf = eax;
+
+  memcpy (cpu_features.vendor + 0, &ebx, 4);
+  memcpy (cpu_features.vendor + 4, &edx, 4);
+  memcpy (cpu_features.vendor + 8, &ecx, 4);
+
+  cpuid (CPUID_LEAF_EXT, &eax, &ebx, &ecx, &edx);
+
+  cpu_features.max_ext_leaf = (eax & CPUID_LEAF_EXT) ? eax : 0;
+
+  if (cpu_features.max_ext_leaf >= CPUID_LEAF_BRAND + 2)
+    for (i = 0; i < 3; ++i)
+    {
+      cpuid (CPUID_LEAF_BRAND + i, &brand[0], &brand[1], &brand[2], &brand[3]);
+      memcpy (cpu_features.brand + 16 * i, brand, 16);
+    }
+}
+
+static void
+cpu_detect_features (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  if (cpu_features.max_leaf >= CPUID_LEAF_FEATURES)
+  {
+    cpuid (CPUID_LEAF_FEATURES, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.stepping = eax & 0xf;
+    cpu_features.model    = (eax >> 4) & 0xf;
+    cpu_features.family   = (eax >> 8) & 0xf;
+
+    if (cpu_features.family == 0xf)
+      cpu_features.family += (eax >> 20) & 0xff;
+
+    if (cpu_features.family >= 6)
+      cpu_features.model |= ((eax >> 16) & 0xf) << 4;
+
+    cpu_features.words[CPU_WORD_1_EDX] = edx;
+    cpu_features.words[CPU_WORD_1_ECX] = ecx;
+
+    if (edx & (1 << (CPU_FEATURE_CLFSH & 31)))
+      cpu_features.cache_line_size = ((ebx >> 8) & 0xff) * 8;
+  }
+
+  if (cpu_features.max_leaf >= CPUID_LEAF_EXT_FEATURES7)
+  {
+    cpuid_count (CPUID_LEAF_EXT_FEATURES7, 0, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.words[CPU_WORD_7_EBX] = ebx;
+  }
+
+  if (cpu_features.max_ext_leaf >= CPUID_LEAF_EXT_FEATURES)
+  {
+    cpuid (CPUID_LEAF_EXT_FEATURES, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.words[CPU_WORD_EXT_EDX] = edx;
+    cpu_features.words[CPU_WORD_EXT_ECX] = ecx;
+  }
+
+  if (cpu_features.max_ext_leaf >= CPUID_LEAF_POWER)
+  {
+    cpuid (CPUID_LEAF_POWER, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.words[CPU_WORD_POWER_EDX] = edx;
+  }
+}
+
+static void
+cpu_detect_caches (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint32_t regs[4];
+  unsigned int size, line, i, j, n = 0;
+
+  if (cpu_features.max_leaf >= CPUID_LEAF_CACHE_DESC)
+  {
+    cpuid (CPUID_LEAF_CACHE_DESC, &regs[0], &regs[1], &regs[2], &regs[3]);
+
+    /* Bit 31 set means the register holds no descriptors. The lowest
+       byte of EAX is the iteration count, not a descriptor. */
+    for (i = 0; i < 4; ++i)
+      if (!(regs[i] & 0x80000000))
+        for (j = i == 0 ? 1 : 0; j < 4; ++j)
+          if ((regs[i] >> (8 * j)) & 0xff)
+            cpu_features.descriptors[n++] = (regs[i] >> (8 * j)) & 0xff;
+  }
+
+  /* Deterministic cache parameters (Intel) */
+  if (cpu_features.max_leaf >= CPUID_LEAF_CACHE_PARAMS)
+    for (i = 0; ; ++i)
+    {
+      cpuid_count (CPUID_LEAF_CACHE_PARAMS, i, &eax, &ebx, &ecx, &edx);
+
+      if ((eax & 0x1f) == 0)
+        break;
+
+      line = (ebx & 0xfff) + 1;
+      size = ((ebx >> 22) + 1) * (((ebx >> 12) & 0x3ff) + 1) * line * (ecx + 1);
+      size >>= 10;
+
+      switch ((eax >> 5) & 7)
+      {
+        case 1:
+          if ((eax & 0x1f) == 2)
+            cpu_features.l1i_size = size;
+          else
+          {
+            cpu_features.l1d_size = size;
+
+            if (cpu_features.cache_line_size == 0)
+              cpu_features.cache_line_size = line;
+          }
+          break;
+
+        case 2:
+          cpu_features.l2_size = size;
+          break;
+
+        case 3:
+          cpu_features.l3_size = size;
+          break;
+      }
+    }
+
+  /* AMD extended leaves */
+  if (cpu_features.l1d_size == 0 && cpu_features.max_ext_leaf >= CPUID_LEAF_AMD_L1)
+  {
+    cpuid (CPUID_LEAF_AMD_L1, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.l1d_size = ecx >> 24;
+    cpu_features.l1i_size = edx >> 24;
+
+    if (cpu_features.cache_line_size == 0)
+      cpu_features.cache_line_size = ecx & 0xff;
+  }
+
+  if (cpu_features.l2_size == 0 && cpu_features.max_ext_leaf >= CPUID_LEAF_AMD_L2)
+  {
+    cpuid (CPUID_LEAF_AMD_L2, &eax, &ebx, &ecx, &edx);
+
+    cpu_features.l2_size = ecx >> 16;
+    cpu_features.l3_size = (edx >> 18) * 512;
+  }
+
+  if (cpu_features.cache_line_size == 0)
+    cpu_features.cache_line_size = CACHE_LINE_SIZE;
+}
+
+const struct cpu_features *
+i386_cpu_features (void)
+{
+  return &cpu_features;
+}
+
+void
+i386_cpu_dump (void)
+{
+  unsigned int i;
+
+  printf ("CPU: %s family %u model %u stepping %u%s%s\n",
+          cpu_features.vendor[0] != '\0' ? cpu_features.vendor : "(no CPUID)",
+          cpu_features.family,
+          cpu_features.model,
+          cpu_features.stepping,
+          cpu_features.brand[0] != '\0' ? ", " : "",
+          cpu_features.brand);
+
+  printf ("  caches: L1d %u KiB, L1i %u KiB, L2 %u KiB, L3 %u KiB, %u-byte lines\n",
+          cpu_features.l1d_size,
+          cpu_features.l1i_size,
+          cpu_features.l2_size,
+          cpu_features.l3_size,
+          cpu_features.cache_line_size);
+
+  printf ("  features:");
+
+  for (i = 0; i < sizeof (cpu_feature_names) / sizeof (cpu_feature_names[0]); ++i)
+    if (i386_cpu_has (cpu_feature_names[i].feature))
+      printf (" %s", cpu_feature_names[i].name);
+
+  printf ("\n");
+}
+
+void
+i386_cpu_init (void)
+{
+  if (!cpu_has_cpuid ())
+  {
+    cpu_features.family          = 4;
+    cpu_features.cache_line_size = CACHE_LINE_SIZE;
+    return;
+  }
+
+  cpu_detect_identity ();
+
+  cpu_detect_features ();
+
+  cpu_detect_caches ();
+}
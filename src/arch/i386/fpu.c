@@ -0,0 +1,269 @@
+/*
+ *    fpu.c: Lazy FPU context switching
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <atomic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <i386-alternative.h>
+#include <i386-cpuid.h>
+#include <i386-fpu.h>
+#include <i386-int.h>
+#include <i386-regs.h>
+
+/* The FPU registers of each CPU hold the state of at most one thread,
+   its owner. Every switch sets CR0.TS, so the first FPU instruction of
+   the thread switched in raises #NM. That is when the registers change
+   hands, or, if the thread already owns them, when they are just handed
+   back without a restore. Threads that never touch the FPU never pay
+   for it, not even in memory: their save area is only allocated on
+   first use.
+
+   As threads may move between CPUs, the state must be in memory once
+   the owner is switched out. Since TS is set until the #NM, the
+   registers can only have changed if the thread took one during this
+   run: only then does __arch_fpu_flush write them back. An owner that
+   did not use the FPU this time pays neither a save nor a restore.
+   Whenever a CPU loads a state, it disowns the copies other CPUs may
+   still hold, so no CPU ever writes to the save area of a thread
+   running elsewhere. */
+struct fpu_cpu
+{
+  void **owner;   /* Slot whose state is in the registers, if any */
+  void **current; /* Slot of the running thread */
+  int    dirty;   /* The registers may differ from OWNER's save area */
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static struct fpu_cpu fpu_cpus[CPU_MAX];
+
+static int    fpu_fxsr;
+static int    fpu_sse;
+static size_t fpu_state_size;
+
+static inline void
+fpu_set_ts (void)
+{
+  uint32_t cr0;
+
+  GET_REGISTER ("%cr0", cr0);
+
+  if (!(cr0 & CR0_TS))
+    SET_REGISTER ("%cr0", cr0 | CR0_TS);
+}
+
+static inline void
+fpu_clts (void)
+{
+  __asm__ __volatile__ ("clts" ::: "memory");
+}
+
+/* No FXSR check at run time: the FNSAVE/FRSTOR versions are patched
+   at boot on CPUs that have it */
+static inline void
+fpu_save (void *state)
+{
+  __asm__ __volatile__ (ALTERNATIVE ("fnsave (%0)\n\tfwait",
+                                     "fxsave (%0)",
+                                     CPU_FEATURE_FXSR)
+                        :: "r" (state) : "memory");
+}
+
+static inline void
+fpu_restore (const void *state)
+{
+  __asm__ __volatile__ (ALTERNATIVE ("frstor (%0)",
+                                     "fxrstor (%0)",
+                                     CPU_FEATURE_FXSR)
+                        :: "r" (state) : "memory");
+}
+
+static inline void
+fpu_reset (void)
+{
+  uint32_t mxcsr = FPU_MXCSR_DEFAULT;
+
+  __asm__ __volatile__ ("fninit" ::: "memory");
+
+  /* FNINIT leaves MXCSR alone: don't inherit the previous owner's */
+  if (fpu_sse)
+    __asm__ __volatile__ ("ldmxcsr %0" :: "m" (mxcsr));
+}
+
+/* SELF may be NULL, to disown SLOT everywhere */
+static void
+fpu_disown (void **slot, struct fpu_cpu *self)
+{
+  unsigned int i;
+
+  for (i = 0; i < CPU_MAX; ++i)
+    if (&fpu_cpus[i] != self)
+      (void) a_cas_p (&fpu_cpus[i].owner, slot, NULL);
+}
+
+static void
+fpu_nm_handler (struct x86_stack_frame *frame, void *data)
+{
+  struct fpu_cpu *cpu = &fpu_cpus[__arch_cpu_id ()];
+
+  fpu_clts ();
+
+  /* No thread running (early boot): the kernel just borrows the FPU */
+  if (cpu->current == NULL)
+  {
+    cpu->owner = NULL;
+    return;
+  }
+
+  cpu->dirty = 1;
+
+  if (cpu->owner == cpu->current)
+    return;
+
+  /* Written back when it was switched out, if it had changed */
+  cpu->owner = NULL;
+
+  fpu_disown (cpu->current, cpu);
+
+  if (*cpu->current == NULL)
+  {
+    if ((*cpu->current = malloc (fpu_state_size)) == NULL)
+    {
+      printf ("fpu: cannot allocate FPU state\n");
+      __arch_machine_halt ();
+    }
+
+    fpu_reset ();
+  }
+  else
+    fpu_restore (*cpu->current);
+
+  cpu->owner = cpu->current;
+}
+
+void
+__arch_fpu_switch (void **slot)
+{
+  struct fpu_cpu *cpu;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = &fpu_cpus[__arch_cpu_id ()];
+
+  cpu->current = slot;
+  cpu->dirty   = 0;
+
+  fpu_set_ts ();
+
+  __arch_irq_restore (flags);
+}
+
+void
+__arch_fpu_flush (void **slot)
+{
+  struct fpu_cpu *cpu;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = &fpu_cpus[__arch_cpu_id ()];
+
+  /* Dirty: TS is clear */
+  if (cpu->owner == slot && slot != NULL && cpu->dirty)
+  {
+    fpu_save (*slot);
+
+    cpu->dirty = 0;
+  }
+
+  __arch_irq_restore (flags);
+}
+
+void
+__arch_fpu_free (void **slot)
+{
+  struct fpu_cpu *cpu;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = &fpu_cpus[__arch_cpu_id ()];
+
+  /* Whatever is in the registers is garbage now. The slot itself may
+     be reused by a new thread: no CPU may take its registers for it. */
+  fpu_disown (slot, NULL);
+
+  if (cpu->current == slot)
+    cpu->current = NULL;
+
+  __arch_irq_restore (flags);
+
+  free (*slot);
+
+  *slot = NULL;
+}
+
+size_t
+__arch_fpu_state_size (void)
+{
+  return fpu_state_size;
+}
+
+void
+i386_fpu_init_cpu (void)
+{
+  uint32_t cr0, cr4;
+
+  GET_REGISTER ("%cr0", cr0);
+
+  cr0 &= ~(CR0_EM | CR0_TS);
+  cr0 |= CR0_MP | CR0_NE;
+
+  SET_REGISTER ("%cr0", cr0);
+
+  if (fpu_fxsr)
+  {
+    GET_REGISTER ("%cr4", cr4);
+
+    cr4 |= CR4_OSFXSR;
+
+    if (fpu_sse)
+      cr4 |= CR4_OSXMMEXCPT;
+
+    SET_REGISTER ("%cr4", cr4);
+  }
+
+  fpu_reset ();
+}
+
+void
+i386_fpu_init (void)
+{
+  fpu_fxsr = i386_cpu_has (CPU_FEATURE_FXSR);
+  fpu_sse  = fpu_fxsr && i386_cpu_has (CPU_FEATURE_SSE);
+
+  fpu_state_size = fpu_fxsr ? FPU_FXSAVE_SIZE : FPU_FSAVE_SIZE;
+
+  i386_fpu_init_cpu ();
+
+  (void) i386_int_register (INT_EXCEPTION_NM, fpu_nm_handler, NULL);
+}
@@ -0,0 +1,137 @@
+/*
+ *    gdt.c: Segmentation (GDT and TSS)
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stddef.h>
+
+#include <i386-percpu.h>
+#include <i386-seg.h>
+
+/* Flat segments: segmentation is only used to switch privilege levels
+   and to find per-CPU data. Each CPU has its own GDT, as the per-CPU
+   segment and the TSS (whose descriptor gets marked busy) differ. */
+static struct i386_cpu i386_cpus[CPU_MAX];
+
+static void
+gdt_set_entry (struct gdt_entry *gdt,
+               unsigned int entry,
+               uint32_t base,
+               uint32_t limit,
+               uint8_t access,
+               uint8_t flags)
+{
+  gdt[entry].limit_low        = limit & 0xffff;
+  gdt[entry].base_low         = base & 0xffff;
+  gdt[entry].base_mid         = (base >> 16) & 0xff;
+  gdt[entry].access           = access;
+  gdt[entry].flags_limit_high = (flags << 4) | ((limit >> 16) & 0x0f);
+  gdt[entry].base_high        = base >> 24;
+}
+
+struct i386_cpu *
+i386_cpu_of (unsigned int id)
+{
+  return &i386_cpus[id];
+}
+
+void
+i386_tss_set_kernel_stack (uint32_t esp0)
+{
+  i386_this_cpu ()->tss.esp0 = esp0;
+}
+
+uint32_t *
+i386_tss_kernel_stack_slot (void)
+{
+  /* The TSS is packed, but esp0 is naturally aligned all the same */
+  return (uint32_t *)
+    ((uint8_t *) &i386_this_cpu ()->tss + offsetof (struct x86_tss, esp0));
+}
+
+void
+i386_gdt_init (unsigned int id)
+{
+  struct i386_cpu *cpu = &i386_cpus[id];
+  struct gdt_entry *gdt = cpu->gdt;
+  struct x86_table_register gdtr;
+
+  cpu->self = cpu;
+  cpu->id   = id;
+
+  gdt_set_entry (gdt, GDT_ENTRY_NULL, 0, 0, 0, 0);
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_KERNEL_CODE,
+    0, 0xfffff,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (0) | GDT_ACCESS_SEGMENT | GDT_ACCESS_CODE,
+    GDT_FLAGS_4K | GDT_FLAGS_32BIT);
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_KERNEL_DATA,
+    0, 0xfffff,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (0) | GDT_ACCESS_SEGMENT | GDT_ACCESS_DATA,
+    GDT_FLAGS_4K | GDT_FLAGS_32BIT);
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_USER_CODE,
+    0, 0xfffff,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (3) | GDT_ACCESS_SEGMENT | GDT_ACCESS_CODE,
+    GDT_FLAGS_4K | GDT_FLAGS_32BIT);
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_USER_DATA,
+    0, 0xfffff,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (3) | GDT_ACCESS_SEGMENT | GDT_ACCESS_DATA,
+    GDT_FLAGS_4K | GDT_FLAGS_32BIT);
+
+  cpu->tss.ss0        = KERNEL_DATA_SELECTOR;
+  cpu->tss.iomap_base = sizeof (struct x86_tss); /* No I/O permission bitmap */
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_TSS,
+    (uint32_t) &cpu->tss, sizeof (struct x86_tss) - 1,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (0) | GDT_ACCESS_TSS,
+    0);
+
+  gdt_set_entry (
+    gdt, GDT_ENTRY_PERCPU,
+    (uint32_t) cpu, sizeof (struct i386_cpu) - 1,
+    GDT_ACCESS_PRESENT | GDT_ACCESS_DPL (0) | GDT_ACCESS_SEGMENT | GDT_ACCESS_DATA,
+    GDT_FLAGS_32BIT);
+
+  gdtr.limit = sizeof (cpu->gdt) - 1;
+  gdtr.base  = (uint32_t) gdt;
+
+  __asm__ __volatile__ ("lgdt %0\n"
+                        "ljmp %1, $1f\n"
+                        "1:\n"
+                        "movw %2, %%ax\n"
+                        "movw %%ax, %%ds\n"
+                        "movw %%ax, %%es\n"
+                        "movw %%ax, %%gs\n"
+                        "movw %%ax, %%ss\n"
+                        "movw %3, %%ax\n"
+                        "movw %%ax, %%fs\n"
+                        "ltr %w4" ::
+                        "m" (gdtr),
+                        "i" (KERNEL_CODE_SELECTOR),
+                        "i" (KERNEL_DATA_SELECTOR),
+                        "i" (PERCPU_SELECTOR),
+                        "r" (TSS_SELECTOR) : "eax", "memory");
+}
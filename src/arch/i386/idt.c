@@ -0,0 +1,245 @@
+/*
+ *    idt.c: Interrupt descriptor table and dispatch
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+
+#include <ksyms.h>
+
+#include <i386-backtrace.h>
+#include <i386-int.h>
+#include <i386-seg.h>
+
+/* Frames shown when dying of an unhandled exception */
+#define INT_BACKTRACE_DEPTH 16
+
+struct int_entry
+{
+  i386_int_handler_t handler;
+  void              *data;
+};
+
+extern char isr_stubs[];
+
+static struct idt_entry idt[IDT_ENTRIES] __attribute__ ((aligned (8)));
+
+static struct int_entry int_table[IDT_ENTRIES];
+
+/* Innermost frame being handled on each CPU, for profiling */
+static struct x86_stack_frame *int_frames[CPU_MAX];
+
+static void (*int_preempt_hook) (int);
+
+/* Nonzero while the hook must not run on that CPU */
+static unsigned int int_preempt_off[CPU_MAX];
+
+static const char *int_exception_names[INT_VECTOR_EXCEPTIONS] =
+{
+  "divide error", "debug", "NMI", "breakpoint", "overflow",
+  "bound range exceeded", "invalid opcode", "device not available",
+  "double fault", "coprocessor segment overrun", "invalid TSS",
+  "segment not present", "stack fault", "general protection fault",
+  "page fault", "reserved", "x87 floating point error", "alignment check",
+  "machine check", "SIMD floating point error"
+};
+
+static void
+idt_set_gate_offset (unsigned int vector, uint32_t offset, uint8_t type_attr)
+{
+  idt[vector].offset_low  = offset & 0xffff;
+  idt[vector].selector    = KERNEL_CODE_SELECTOR;
+  idt[vector].zero        = 0;
+  idt[vector].type_attr   = type_attr;
+  idt[vector].offset_high = offset >> 16;
+}
+
+static void
+idt_set_gate (unsigned int vector, uint8_t type_attr)
+{
+  idt_set_gate_offset (
+    vector,
+    (uint32_t) isr_stubs + vector * INT_STUB_SIZE,
+    type_attr);
+}
+
+void
+i386_int_set_raw (unsigned int vector, void (*entry) (void))
+{
+  if (vector < IDT_ENTRIES)
+    idt_set_gate_offset (vector, (uint32_t) entry, idt[vector].type_attr);
+}
+
+void
+i386_int_set_user (unsigned int vector)
+{
+  if (vector < IDT_ENTRIES)
+    idt[vector].type_attr |= IDT_GATE_DPL (3);
+}
+
+int
+i386_int_register (unsigned int vector, i386_int_handler_t handler, void *data)
+{
+  if (vector >= IDT_ENTRIES || int_table[vector].handler != NULL)
+    return -1;
+
+  int_table[vector].data    = data;
+  int_table[vector].handler = handler;
+
+  return 0;
+}
+
+static void
+int_print_address (uintptr_t addr)
+{
+  const char *name;
+  uintptr_t offset;
+
+  if ((name = ksym_lookup (addr, &offset)) != NULL)
+    printf ("    0x%08x  %s+0x%x\n", addr, name, offset);
+  else
+    printf ("    0x%08x\n", addr);
+}
+
+static void
+int_unhandled (struct x86_stack_frame *frame)
+{
+  uintptr_t pcs[INT_BACKTRACE_DEPTH];
+  unsigned int i, n;
+  const char *name = NULL;
+
+  /* Stray IRQs and unknown software interrupts are just ignored */
+  if (frame->int_no >= INT_VECTOR_EXCEPTIONS)
+    return;
+
+  name = int_exception_names[frame->int_no];
+
+  printf ("Unhandled exception %u (%s), error code 0x%x\n",
+          frame->int_no,
+          name != NULL ? name : "reserved",
+          frame->priv.error);
+
+  printf ("  eip: 0x%08x  cs: 0x%04x  eflags: 0x%08x\n",
+          frame->priv.eip,
+          frame->priv.cs,
+          frame->priv.eflags);
+
+  printf ("  eax: 0x%08x  ebx: 0x%08x  ecx: 0x%08x  edx: 0x%08x\n",
+          frame->regs.eax, frame->regs.ebx, frame->regs.ecx, frame->regs.edx);
+
+  printf ("  esi: 0x%08x  edi: 0x%08x  ebp: 0x%08x\n",
+          frame->regs.esi, frame->regs.edi, frame->regs.ebp);
+
+  if (X86_FRAME_FROM_USER (frame))
+    printf ("  esp: 0x%08x  ss: 0x%04x  cr3: 0x%08x\n",
+            frame->unpriv.old_esp,
+            frame->unpriv.old_ss,
+            frame->cr3);
+  else
+  {
+    printf ("  backtrace:\n");
+
+    int_print_address (frame->priv.eip);
+
+    n = i386_backtrace (frame->regs.ebp, pcs, INT_BACKTRACE_DEPTH);
+
+    for (i = 0; i < n; ++i)
+      int_print_address (pcs[i]);
+  }
+
+  __arch_machine_halt ();
+}
+
+void
+i386_int_dispatch (struct x86_stack_frame *frame)
+{
+  struct int_entry *entry = &int_table[frame->int_no];
+  struct x86_stack_frame **current = &int_frames[__arch_cpu_id ()];
+  struct x86_stack_frame *outer = *current;
+
+  *current = frame;
+
+  if (entry->handler != NULL)
+    (entry->handler) (frame, entry->data);
+  else
+    int_unhandled (frame);
+
+  *current = outer;
+
+  /* Leaving the outermost handler: the thread may be switched away from
+     here, and this frame resumed when it is switched back in */
+  if (outer == NULL)
+    i386_int_preempt (X86_FRAME_FROM_USER (frame));
+}
+
+void
+i386_int_preempt (int from_user)
+{
+  if (int_preempt_hook != NULL && !int_preempt_off[__arch_cpu_id ()])
+    (int_preempt_hook) (from_user);
+}
+
+void
+i386_int_preempt_disable (void)
+{
+  ++int_preempt_off[__arch_cpu_id ()];
+}
+
+void
+i386_int_preempt_enable (void)
+{
+  --int_preempt_off[__arch_cpu_id ()];
+}
+
+void
+__arch_preempt_init (void (*hook) (int))
+{
+  int_preempt_hook = hook;
+}
+
+struct x86_stack_frame *
+i386_int_current_frame (void)
+{
+  return int_frames[__arch_cpu_id ()];
+}
+
+/* All CPUs share the same IDT */
+void
+i386_idt_load (void)
+{
+  struct x86_table_register idtr;
+
+  idtr.limit = sizeof (idt) - 1;
+  idtr.base  = (uint32_t) idt;
+
+  __asm__ __volatile__ ("lidt %0" :: "m" (idtr) : "memory");
+}
+
+void
+i386_idt_init (void)
+{
+  unsigned int i;
+
+  /* Everything is an interrupt gate: handlers decide when to let other
+     interrupts in */
+  for (i = 0; i < IDT_ENTRIES; ++i)
+    idt_set_gate (i, IDT_GATE_PRESENT | IDT_GATE_DPL (0) | IDT_GATE_INTERRUPT);
+
+  i386_idt_load ();
+}
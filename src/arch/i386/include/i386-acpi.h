@@ -0,0 +1,119 @@
+/*
+ *    i386-acpi.h: ACPI table definitions
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_ACPI_H
+#define _ARCH_I386_ACPI_H
+
+#define ACPI_RSDP_SIGNATURE     "RSD PTR "
+#define ACPI_MADT_SIGNATURE     "APIC"
+
+/* Where the RSDP may be found, 16-byte aligned */
+#define ACPI_EBDA_SEGMENT_PTR   0x40e
+#define ACPI_EBDA_SEARCH_SIZE   1024
+#define ACPI_BIOS_AREA_START    0xe0000
+#define ACPI_BIOS_AREA_END      0x100000
+
+#define ACPI_MADT_PCAT_COMPAT   1 /* Dual 8259 present */
+
+#define ACPI_MADT_LAPIC         0
+#define ACPI_MADT_IOAPIC        1
+#define ACPI_MADT_OVERRIDE      2
+#define ACPI_MADT_LAPIC_ADDRESS 5
+
+#define ACPI_MADT_LAPIC_ENABLED 1
+
+struct acpi_rsdp
+{
+  char     signature[8];
+  uint8_t  checksum;
+  char     oem_id[6];
+  uint8_t  revision;
+  uint32_t rsdt;
+
+  /* ACPI 2.0+ */
+  uint32_t length;
+  uint64_t xsdt;
+  uint8_t  ext_checksum;
+  uint8_t  reserved[3];
+} __attribute__ ((packed));
+
+#define ACPI_RSDP_V1_LENGTH 20
+
+struct acpi_sdt_header
+{
+  char     signature[4];
+  uint32_t length;
+  uint8_t  revision;
+  uint8_t  checksum;
+  char     oem_id[6];
+  char     oem_table_id[8];
+  uint32_t oem_revision;
+  uint32_t creator_id;
+  uint32_t creator_revision;
+} __attribute__ ((packed));
+
+struct acpi_madt
+{
+  struct acpi_sdt_header header;
+  uint32_t               lapic;
+  uint32_t               flags;
+} __attribute__ ((packed));
+
+struct acpi_madt_entry
+{
+  uint8_t type;
+  uint8_t length;
+
+  union
+  {
+    struct
+    {
+      uint8_t  processor_id;
+      uint8_t  apic_id;
+      uint32_t flags;
+    } __attribute__ ((packed)) lapic;
+
+    struct
+    {
+      uint8_t  id;
+      uint8_t  reserved;
+      uint32_t address;
+      uint32_t gsi_base;
+    } __attribute__ ((packed)) ioapic;
+
+    struct
+    {
+      uint8_t  bus;
+      uint8_t  source;
+      uint32_t gsi;
+      uint16_t flags;
+    } __attribute__ ((packed)) override;
+
+    struct
+    {
+      uint16_t reserved;
+      uint64_t address;
+    } __attribute__ ((packed)) lapic_address;
+  };
+} __attribute__ ((packed));
+
+/* Find and map the ACPI table with the given signature. NULL if there
+   is no such table or its checksum is wrong. */
+const struct acpi_sdt_header *i386_acpi_find_table (const char *);
+
+#endif /* _ARCH_I386_ACPI_H */
@@ -0,0 +1,73 @@
+/*
+ *    i386-alternative.h: Boot-time instruction patching
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_ALTERNATIVE_H
+#define _ARCH_I386_ALTERNATIVE_H
+
+#include <i386-cpuid.h>
+
+#define __ALT_STRINGIFY(x) #x
+#define ALT_STRINGIFY(x)   __ALT_STRINGIFY (x)
+
+/* Each patch site is described by one of these in .altinstructions.
+   When the CPU has FEATURE, the SITE_LEN bytes at SITE are replaced by
+   the REPLACEMENT_LEN bytes at REPLACEMENT, and whatever is left is
+   skipped over. A relative CALL or JMP is only fixed up if it is the
+   first instruction of the replacement. */
+#define ALT_ENTRY(site, site_end, repl, repl_end, feature)    \
+  .pushsection .altinstructions, "a";                         \
+  .long site, repl;                                           \
+  .word feature;                                              \
+  .byte site_end - site, repl_end - repl;                     \
+  .popsection
+
+#ifndef ASM
+
+struct alt_instr
+{
+  uint32_t site;
+  uint32_t replacement;
+  uint16_t feature;
+  uint8_t  site_len;
+  uint8_t  replacement_len;
+} __attribute__ ((packed));
+
+/* For inline assembly: OLD runs until alternatives are applied, and
+   from then on only if the CPU lacks FEATURE. The site is padded so that
+   NEW always fits. */
+#define ALTERNATIVE(old, new, feature)                                  \
+  "661:\n\t" old "\n662:\n\t"                                           \
+  ".skip -(((664f - 663f) - (662b - 661b)) > 0) * "                     \
+  "((664f - 663f) - (662b - 661b)), 0x90\n"                             \
+  "665:\n\t"                                                            \
+  ".pushsection .altinstructions, \"a\"\n\t"                            \
+  ".long 661b, 663f\n\t"                                                \
+  ".word " ALT_STRINGIFY (feature) "\n\t"                               \
+  ".byte 665b - 661b, 664f - 663f\n\t"                                  \
+  ".popsection\n\t"                                                     \
+  ".pushsection .altinstr_replacement, \"ax\"\n"                        \
+  "663:\n\t" new "\n664:\n\t"                                           \
+  ".popsection\n"
+
+/* Patch every site for the features of the boot CPU. Must run before
+   other CPUs are started. */
+void i386_alternatives_apply (void);
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_ALTERNATIVE_H */
@@ -0,0 +1,145 @@
+/*
+ *    i386-apic.h: Local APIC and IO-APIC
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_APIC_H
+#define _ARCH_I386_APIC_H
+
+#include <i386-irq.h>
+
+#define LAPIC_DEFAULT_BASE      0xfee00000
+
+/* Local APIC registers (byte offsets) */
+#define LAPIC_REG_ID            0x020
+#define LAPIC_REG_VERSION       0x030
+#define LAPIC_REG_TPR           0x080
+#define LAPIC_REG_EOI           0x0b0
+#define LAPIC_REG_SVR           0x0f0
+#define LAPIC_REG_ESR           0x280
+#define LAPIC_REG_ICR_LOW       0x300
+#define LAPIC_REG_ICR_HIGH      0x310
+#define LAPIC_REG_LVT_TIMER     0x320
+#define LAPIC_REG_LVT_LINT0     0x350
+#define LAPIC_REG_LVT_LINT1     0x360
+#define LAPIC_REG_LVT_ERROR     0x370
+#define LAPIC_REG_TIMER_INITIAL 0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3e0
+
+#define LAPIC_SVR_ENABLE        (1 << 8)
+#define LAPIC_LVT_MASKED        (1 << 16)
+
+/* Interrupt command register, low half (fixed delivery is 0) */
+#define LAPIC_ICR_INIT          (5 << 8)
+#define LAPIC_ICR_STARTUP       (6 << 8)  /* Vector is the start page */
+#define LAPIC_ICR_PENDING       (1 << 12)
+#define LAPIC_ICR_ASSERT        (1 << 14)
+#define LAPIC_ICR_LEVEL         (1 << 15)
+
+/* IO-APIC registers: an index register and a data window */
+#define IOAPIC_REG_SELECT       0x00
+#define IOAPIC_REG_WINDOW       0x10
+
+#define IOAPIC_ID               0x00
+#define IOAPIC_VERSION          0x01
+#define IOAPIC_REDIRECTION(pin) (0x10 + 2 * (pin))
+
+#define IOAPIC_RTE_POLARITY_LOW (1 << 13)
+#define IOAPIC_RTE_LEVEL        (1 << 15)
+#define IOAPIC_RTE_MASKED       (1 << 16)
+
+/* MPS INTI flags, shared by the MP tables and the ACPI MADT */
+#define INTI_POLARITY_MASK      0x03
+#define INTI_POLARITY_LOW       0x03
+#define INTI_TRIGGER_MASK       0x0c
+#define INTI_TRIGGER_LEVEL      0x0c
+
+#define APIC_MAX_IOAPICS        8
+#define APIC_GSI_AUTO           ((uint32_t) -1)
+#define APIC_GSI_NONE           ((uint32_t) -2) /* ISA IRQ not wired */
+
+struct ioapic
+{
+  uint8_t            id;
+  uint32_t           gsi_base;
+  unsigned int       pins;
+  volatile uint32_t *regs;
+};
+
+/* What firmware tables tell about the interrupt topology */
+struct apic_config
+{
+  uint32_t      lapic_phys;
+  int           has_8259;     /* Legacy PICs are present and must be masked */
+  int           has_imcr;     /* PIC mode must be left through the IMCR */
+
+  unsigned int  cpu_count;
+  uint8_t       cpu_apic_ids[CPU_MAX];
+
+  unsigned int  ioapic_count;
+  struct ioapic ioapics[APIC_MAX_IOAPICS];
+
+  /* Global system interrupt (or APIC_GSI_NONE) and INTI flags of each
+     ISA IRQ */
+  uint32_t      isa_gsi[IRQ_COUNT];
+  uint16_t      isa_flags[IRQ_COUNT];
+};
+
+/* Firmware table parsers. Return 0 if the tables were found and usable */
+int  i386_acpi_parse_madt (struct apic_config *);
+int  i386_mptable_parse (struct apic_config *);
+
+void i386_apic_config_add_cpu (struct apic_config *, uint8_t);
+
+/* ISA IRQ is wired to GSI, with the given INTI flags. The IRQ that was
+   assumed to be wired there (ISA IRQs are identity-mapped by default)
+   is then left unrouted. */
+void i386_apic_config_set_isa_irq (struct apic_config *, unsigned int, uint32_t, uint16_t);
+
+/* GSI_BASE may be APIC_GSI_AUTO: the IO-APIC then takes the GSIs right
+   after the previous one (MP tables do not tell) */
+int  i386_apic_config_add_ioapic (struct apic_config *, uint8_t, uint32_t, uint32_t);
+
+/* Switch from the 8259 to the APICs. Returns -1 if there are none. */
+int  i386_apic_init (void);
+
+uint32_t i386_lapic_read (uint32_t);
+void     i386_lapic_write (uint32_t, uint32_t);
+
+/* APIC ID of the calling CPU */
+uint8_t  i386_lapic_id (void);
+
+/* Send an IPI described by COMMAND (an ICR low word) to APIC_ID */
+void     i386_lapic_send_ipi (uint8_t, uint32_t);
+
+/* Enable the local APIC of the calling CPU. i386_apic_init does it for
+   the boot CPU. */
+void     i386_lapic_init_cpu (void);
+
+/* Program the local APIC timer of the calling CPU like the boot CPU's,
+   if the timer is the local APIC's (see __arch_timer_init) */
+void     i386_lapic_timer_init_cpu (void);
+
+/* Nonzero if interrupts are delivered through the APICs */
+int i386_apic_enabled (void);
+
+/* What the firmware told us, valid after i386_apic_init */
+const struct apic_config *i386_apic_config (void);
+
+extern const struct irq_controller i386_apic;
+
+#endif /* _ARCH_I386_APIC_H */
@@ -0,0 +1,26 @@
+/*
+ *    i386-backtrace.h: Frame pointer stack walking
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_BACKTRACE_H
+#define _ARCH_I386_BACKTRACE_H
+
+/* Walk the EBP chain starting at the given frame, storing up to MAX
+   return addresses. Stops at the first one outside kernel text. */
+unsigned int i386_backtrace (uint32_t, uintptr_t *, unsigned int);
+
+#endif /* _ARCH_I386_BACKTRACE_H */
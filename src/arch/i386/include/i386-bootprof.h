@@ -0,0 +1,52 @@
+/*
+ *    i386-bootprof.h: Boot phase profiling
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_BOOTPROF_H
+#define _ARCH_I386_BOOTPROF_H
+
+#include <i386-layout.h>
+
+#define BOOT_MARK_MAX 32
+
+/* Each mark closes the phase started by the previous one */
+struct boot_mark
+{
+  const char *phase;
+  uint64_t    tsc;
+};
+
+extern struct boot_mark boot_marks[BOOT_MARK_MAX];
+extern unsigned int     boot_mark_count;
+
+/* Usable before paging: expands to plain code, as boot functions may
+   not call anything outside .bootcode. Only the address of PHASE is
+   stored, so a string literal (linked in the upper half) is fine. */
+#define BOOT_MARK(name)                                           \
+  do                                                              \
+  {                                                               \
+    if (boot_mark_count < BOOT_MARK_MAX)                          \
+    {                                                             \
+      boot_marks[boot_mark_count].phase = (name);                 \
+      __asm__ __volatile__ ("rdtsc" :                             \
+                            "=A" (boot_marks[boot_mark_count].tsc)); \
+      ++boot_mark_count;                                          \
+    }                                                             \
+  }                                                               \
+  while (0)
+
+#endif /* _ARCH_I386_BOOTPROF_H */
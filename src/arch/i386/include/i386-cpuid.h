@@ -0,0 +1,143 @@
+/*
+ *    i386-cpuid.h: CPUID leaves and feature bits
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_CPUID_H
+#define _ARCH_I386_CPUID_H
+
+#define CPUID_LEAF_VENDOR        0x00000000
+#define CPUID_LEAF_FEATURES      0x00000001
+#define CPUID_LEAF_CACHE_DESC    0x00000002 /* Intel cache/TLB descriptors */
+#define CPUID_LEAF_CACHE_PARAMS  0x00000004 /* Intel deterministic cache parameters */
+#define CPUID_LEAF_EXT_FEATURES7 0x00000007
+#define CPUID_LEAF_EXT           0x80000000
+#define CPUID_LEAF_EXT_FEATURES  0x80000001
+#define CPUID_LEAF_BRAND         0x80000002 /* To 0x80000004 */
+#define CPUID_LEAF_AMD_L1        0x80000005
+#define CPUID_LEAF_AMD_L2        0x80000006
+#define CPUID_LEAF_POWER         0x80000007
+
+/* CPUID_LEAF_FEATURES, EDX. Boot code tests these directly. */
+#define CPUID_EDX_PSE            (1 <<  3)
+#define CPUID_EDX_MSR            (1 <<  5)
+#define CPUID_EDX_APIC           (1 <<  9)
+#define CPUID_EDX_SEP            (1 << 11) /* SYSENTER/SYSEXIT */
+#define CPUID_EDX_PGE            (1 << 13)
+#define CPUID_EDX_FXSR           (1 << 24) /* FXSAVE/FXRSTOR */
+#define CPUID_EDX_SSE            (1 << 25)
+
+/* Everything else goes through i386_cpu_has with one of these: the
+   CPUID register holding the flag, and its bit. Plain numbers, so that
+   they can be stringified into alternatives (see i386-alternative.h). */
+#define CPU_WORD_1_EDX           0
+#define CPU_WORD_1_ECX           1
+#define CPU_WORD_EXT_EDX         2
+#define CPU_WORD_EXT_ECX         3
+#define CPU_WORD_POWER_EDX       4
+#define CPU_WORD_7_EBX           5
+#define CPU_WORDS                6
+
+#define CPU_FEATURE(word, bit)   ((word) * 32 + (bit))
+
+#define CPU_FEATURE_FPU          CPU_FEATURE (CPU_WORD_1_EDX,      0)
+#define CPU_FEATURE_PSE          CPU_FEATURE (CPU_WORD_1_EDX,      3)
+#define CPU_FEATURE_TSC          CPU_FEATURE (CPU_WORD_1_EDX,      4)
+#define CPU_FEATURE_MSR          CPU_FEATURE (CPU_WORD_1_EDX,      5)
+#define CPU_FEATURE_PAE          CPU_FEATURE (CPU_WORD_1_EDX,      6)
+#define CPU_FEATURE_CX8          CPU_FEATURE (CPU_WORD_1_EDX,      8)
+#define CPU_FEATURE_APIC         CPU_FEATURE (CPU_WORD_1_EDX,      9)
+#define CPU_FEATURE_SEP          CPU_FEATURE (CPU_WORD_1_EDX,     11)
+#define CPU_FEATURE_PGE          CPU_FEATURE (CPU_WORD_1_EDX,     13)
+#define CPU_FEATURE_CMOV         CPU_FEATURE (CPU_WORD_1_EDX,     15)
+#define CPU_FEATURE_PAT          CPU_FEATURE (CPU_WORD_1_EDX,     16)
+#define CPU_FEATURE_CLFSH        CPU_FEATURE (CPU_WORD_1_EDX,     19)
+#define CPU_FEATURE_MMX          CPU_FEATURE (CPU_WORD_1_EDX,     23)
+#define CPU_FEATURE_FXSR         CPU_FEATURE (CPU_WORD_1_EDX,     24)
+#define CPU_FEATURE_SSE          CPU_FEATURE (CPU_WORD_1_EDX,     25)
+#define CPU_FEATURE_SSE2         CPU_FEATURE (CPU_WORD_1_EDX,     26)
+#define CPU_FEATURE_HTT          CPU_FEATURE (CPU_WORD_1_EDX,     28)
+#define CPU_FEATURE_SSE3         CPU_FEATURE (CPU_WORD_1_ECX,      0)
+#define CPU_FEATURE_SSSE3        CPU_FEATURE (CPU_WORD_1_ECX,      9)
+#define CPU_FEATURE_SSE4_1       CPU_FEATURE (CPU_WORD_1_ECX,     19)
+#define CPU_FEATURE_SSE4_2       CPU_FEATURE (CPU_WORD_1_ECX,     20)
+#define CPU_FEATURE_X2APIC       CPU_FEATURE (CPU_WORD_1_ECX,     21)
+#define CPU_FEATURE_POPCNT       CPU_FEATURE (CPU_WORD_1_ECX,     23)
+#define CPU_FEATURE_TSC_DEADLINE CPU_FEATURE (CPU_WORD_1_ECX,     24)
+#define CPU_FEATURE_XSAVE        CPU_FEATURE (CPU_WORD_1_ECX,     26)
+#define CPU_FEATURE_AVX          CPU_FEATURE (CPU_WORD_1_ECX,     28)
+#define CPU_FEATURE_HYPERVISOR   CPU_FEATURE (CPU_WORD_1_ECX,     31)
+#define CPU_FEATURE_ERMS         CPU_FEATURE (CPU_WORD_7_EBX,      9) /* Fast REP MOVSB */
+#define CPU_FEATURE_NX           CPU_FEATURE (CPU_WORD_EXT_EDX,   20)
+#define CPU_FEATURE_INVARIANT_TSC CPU_FEATURE (CPU_WORD_POWER_EDX, 8)
+
+#ifndef ASM
+
+/* Raw CPUID leaf 2 bytes (first iteration, without the count byte) */
+#define CPU_DESCRIPTORS          15
+
+struct cpu_features
+{
+  char         vendor[13];
+  char         brand[49];
+  uint32_t     max_leaf;
+  uint32_t     max_ext_leaf;
+  unsigned int family;   /* Extended family already added */
+  unsigned int model;    /* Extended model already added */
+  unsigned int stepping;
+  uint32_t     words[CPU_WORDS];
+
+  /* Sizes in KiB, 0 if unknown */
+  unsigned int cache_line_size;
+  unsigned int l1d_size;
+  unsigned int l1i_size;
+  unsigned int l2_size;
+  unsigned int l3_size;
+
+  uint8_t      descriptors[CPU_DESCRIPTORS];
+};
+
+/* Not for boot code: see boot_cpuid */
+static inline void
+cpuid_count (uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+  __asm__ __volatile__ ("cpuid" :
+                        "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx) :
+                        "a" (leaf), "c" (subleaf));
+}
+
+static inline void
+cpuid (uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+  cpuid_count (leaf, 0, eax, ebx, ecx, edx);
+}
+
+/* Fill in the features of the boot CPU. First thing in machine_init. */
+void i386_cpu_init (void);
+
+const struct cpu_features *i386_cpu_features (void);
+
+static inline int
+i386_cpu_has (unsigned int feature)
+{
+  return (i386_cpu_features ()->words[feature >> 5] >> (feature & 31)) & 1;
+}
+
+void i386_cpu_dump (void);
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_CPUID_H */
@@ -0,0 +1,34 @@
+/*
+ *    i386-fpu.h: Lazy FPU context switching
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_FPU_H
+#define _ARCH_I386_FPU_H
+
+/* Save area sizes. FXSAVE needs 16-byte alignment. */
+#define FPU_FXSAVE_SIZE  512
+#define FPU_FSAVE_SIZE   108
+
+#define FPU_MXCSR_DEFAULT 0x1f80 /* All SIMD exceptions masked */
+
+/* Set up CR0/CR4 and the #NM handler */
+void i386_fpu_init (void);
+
+/* Just the CR0/CR4 part, for the other CPUs */
+void i386_fpu_init_cpu (void);
+
+#endif /* _ARCH_I386_FPU_H */
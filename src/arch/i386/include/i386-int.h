@@ -0,0 +1,118 @@
+/*
+ *    i386-int.h: Interrupt descriptor table and dispatch
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_INT_H
+#define _ARCH_I386_INT_H
+
+#define IDT_ENTRIES              256
+
+/* Each entry stub is padded to this size, see isr-i386.S */
+#define INT_STUB_SIZE            16
+
+/* Vectors 0-31 are CPU exceptions. Hardware IRQs come right after. */
+#define INT_VECTOR_EXCEPTIONS    32
+#define INT_VECTOR_IRQ_BASE      0x20
+#define INT_VECTOR_SYSCALL       0x80 /* Fallback system call gate */
+#define INT_VECTOR_TIMER         0xf0 /* Local APIC timer */
+#define INT_VECTOR_KICK          0xf1 /* Inter-processor wake-up */
+#define INT_VECTOR_BENCH_BARE    0xf2 /* Benchmarks, see bench.c */
+#define INT_VECTOR_BENCH         0xf3
+#define INT_VECTOR_BENCH_EXIT    0xf4
+#define INT_VECTOR_SPURIOUS      0xff
+
+#define INT_EXCEPTION_DE         0  /* Divide error */
+#define INT_EXCEPTION_DB         1  /* Debug */
+#define INT_EXCEPTION_NMI        2
+#define INT_EXCEPTION_BP         3  /* Breakpoint */
+#define INT_EXCEPTION_OF         4  /* Overflow */
+#define INT_EXCEPTION_BR         5  /* Bound range exceeded */
+#define INT_EXCEPTION_UD         6  /* Invalid opcode */
+#define INT_EXCEPTION_NM         7  /* Device not available */
+#define INT_EXCEPTION_DF         8  /* Double fault */
+#define INT_EXCEPTION_TS         10 /* Invalid TSS */
+#define INT_EXCEPTION_NP         11 /* Segment not present */
+#define INT_EXCEPTION_SS         12 /* Stack fault */
+#define INT_EXCEPTION_GP         13 /* General protection */
+#define INT_EXCEPTION_PF         14 /* Page fault */
+#define INT_EXCEPTION_MF         16 /* x87 floating point */
+#define INT_EXCEPTION_AC         17 /* Alignment check */
+#define INT_EXCEPTION_MC         18 /* Machine check */
+#define INT_EXCEPTION_XM         19 /* SIMD floating point */
+
+#ifndef ASM
+
+#include <i386-regs.h>
+#include <i386-seg.h>
+
+/* Gate types */
+#define IDT_GATE_PRESENT         0x80
+#define IDT_GATE_DPL(dpl)        ((dpl) << 5)
+#define IDT_GATE_INTERRUPT       0x0e /* Clears IF on entry */
+#define IDT_GATE_TRAP            0x0f /* Leaves IF alone */
+
+struct idt_entry
+{
+  uint16_t offset_low;
+  uint16_t selector;
+  uint8_t  zero;
+  uint8_t  type_attr;
+  uint16_t offset_high;
+} __attribute__ ((packed));
+
+/* Interrupts taken while in the kernel use a reduced frame: segment
+   registers, CR0 and CR3 are not saved (their slots in the frame hold
+   garbage), as they are known to be the kernel's. Only frames coming
+   from userland are complete. */
+#define X86_FRAME_FROM_USER(frame) ((frame)->priv.cs & SELECTOR_RPL_MASK)
+
+typedef void (*i386_int_handler_t) (struct x86_stack_frame *, void *);
+
+void i386_idt_init (void);
+
+/* Load the (already initialized) IDT on another CPU */
+void i386_idt_load (void);
+
+/* Install HANDLER for VECTOR. Returns -1 if the vector is taken. */
+int  i386_int_register (unsigned int, i386_int_handler_t, void *);
+
+/* Allow userland to raise VECTOR with an INT instruction */
+void i386_int_set_user (unsigned int);
+
+/* Point VECTOR straight to ENTRY instead of the common entry path: no
+   frame is built and nothing is dispatched */
+void i386_int_set_raw (unsigned int, void (*) (void));
+
+/* Called by the entry stubs */
+void i386_int_dispatch (struct x86_stack_frame *);
+
+/* Run the preemption hook (see __arch_preempt_init). For kernel exit
+   paths that do not go through i386_int_dispatch. */
+void i386_int_preempt (int);
+
+/* Keep the preemption hook from running on this CPU, so that the
+   current thread is not switched out even if it enters and leaves the
+   kernel with interrupts enabled. Nest; call with interrupts disabled. */
+void i386_int_preempt_disable (void);
+void i386_int_preempt_enable (void);
+
+/* Frame of the interrupt being handled on this CPU, NULL if none */
+struct x86_stack_frame *i386_int_current_frame (void);
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_INT_H */
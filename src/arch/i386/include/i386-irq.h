@@ -0,0 +1,44 @@
+/*
+ *    i386-irq.h: Hardware interrupt requests
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_IRQ_H
+#define _ARCH_I386_IRQ_H
+
+/* ISA IRQ lines */
+#define IRQ_COUNT 16
+
+/* Interrupt controller operations. IRQ numbers are controller inputs,
+   delivered at vector INT_VECTOR_IRQ_BASE + IRQ. */
+struct irq_controller
+{
+  const char *name;
+
+  void (*mask) (unsigned int);
+  void (*unmask) (unsigned int);
+  void (*eoi) (unsigned int);
+
+  /* Nonzero if the IRQ was not really raised. Takes care of whatever
+     acknowledge that case needs. May be NULL. */
+  int (*spurious) (unsigned int);
+};
+
+/* Set up the interrupt controller and route every IRQ to its vector,
+   all of them masked until something attaches to them */
+void i386_irq_init (void);
+
+#endif /* _ARCH_I386_IRQ_H */
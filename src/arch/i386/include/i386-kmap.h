@@ -0,0 +1,39 @@
+/*
+ *    i386-kmap.h: Kernel mappings of arbitrary physical memory
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_KMAP_H
+#define _ARCH_I386_KMAP_H
+
+#include <i386-page.h>
+
+/* Physical memory outside the identity mapping (device registers,
+   firmware tables) is mapped on demand in this window. Its page table
+   is static, so it can be used before the frame allocator is up. */
+#define KMAP_BASE 0xff800000
+#define KMAP_SIZE PAGE_LARGE_SIZE
+
+/* Map SIZE bytes starting at physical address PHYS with the given extra
+   PAGE_FLAG_* bits. Mappings are permanent. Returns NULL if the window
+   is exhausted. */
+void *i386_kmap (uintptr_t, size_t, uint32_t);
+
+/* Uncached mapping, for memory-mapped registers */
+#define i386_ioremap(phys, size) \
+  i386_kmap (phys, size, PAGE_FLAG_CACHE_DISABLE | PAGE_FLAG_WRITE_THROUGH)
+
+#endif /* _ARCH_I386_KMAP_H */
@@ -0,0 +1,45 @@
+/*
+ *    i386-msr.h: Model specific registers
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_MSR_H
+#define _ARCH_I386_MSR_H
+
+#define MSR_APIC_BASE            0x1b
+#define MSR_APIC_BASE_ENABLE     (1 << 11)
+
+#define MSR_SYSENTER_CS          0x174
+#define MSR_SYSENTER_ESP         0x175
+#define MSR_SYSENTER_EIP         0x176
+
+static inline uint64_t
+rdmsr (uint32_t msr)
+{
+  uint64_t value;
+
+  __asm__ __volatile__ ("rdmsr" : "=A" (value) : "c" (msr));
+
+  return value;
+}
+
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  __asm__ __volatile__ ("wrmsr" :: "c" (msr), "A" (value));
+}
+
+#endif /* _ARCH_I386_MSR_H */
@@ -31,4 +31,10 @@
 
 #define PAGE_TABLE_DFL_FLAGS    (PAGE_FLAG_PRESENT | PAGE_FLAG_WRITABLE)
 
+/* Large (PSE) pages, mapped directly by a page directory entry */
+#define PAGE_LARGE_BITS         22
+#define PAGE_LARGE_SIZE         (1 << PAGE_LARGE_BITS)
+#define PAGE_LARGE_MASK         (~(PAGE_LARGE_SIZE - 1))
+#define PAGE_LARGE_PAGES        (1 << (PAGE_LARGE_BITS - PAGE_BITS))
+
 #endif /* _ARCH_I386_PAGE_H */
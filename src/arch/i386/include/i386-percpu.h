@@ -0,0 +1,68 @@
+/*
+ *    i386-percpu.h: Per-CPU data areas
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_PERCPU_H
+#define _ARCH_I386_PERCPU_H
+
+#include <stddef.h>
+
+#include <i386-seg.h>
+
+/* Everything a CPU owns alone. Blocks are cache-line aligned, so that
+   no two CPUs ever write to the same line. In kernel mode, %fs holds
+   PERCPU_SELECTOR, whose base is the running CPU's block: fields are
+   reached with a single %fs-relative access. */
+struct i386_cpu
+{
+  struct i386_cpu  *self;    /* Must be first: %fs:0 */
+  unsigned int      id;
+  uint8_t           apic_id;
+
+  struct gdt_entry  gdt[GDT_ENTRIES] __attribute__ ((aligned (8)));
+  struct x86_tss    tss;
+}
+__attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+/* Block of CPU number ID, from any CPU */
+struct i386_cpu *i386_cpu_of (unsigned int);
+
+static inline struct i386_cpu *
+i386_this_cpu (void)
+{
+  struct i386_cpu *self;
+
+  __asm__ __volatile__ ("movl %%fs:%c1, %0"
+                        : "=r" (self)
+                        : "i" (offsetof (struct i386_cpu, self)));
+
+  return self;
+}
+
+static inline unsigned int
+i386_this_cpu_id (void)
+{
+  unsigned int id;
+
+  __asm__ __volatile__ ("movl %%fs:%c1, %0"
+                        : "=r" (id)
+                        : "i" (offsetof (struct i386_cpu, id)));
+
+  return id;
+}
+
+#endif /* _ARCH_I386_PERCPU_H */
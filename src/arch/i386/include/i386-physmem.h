@@ -0,0 +1,57 @@
+/*
+ *    i386-physmem.h: Physical memory region table
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_PHYSMEM_H
+#define _ARCH_I386_PHYSMEM_H
+
+#include <alltypes.h>
+#include <i386-layout.h>
+#include <multiboot.h>
+
+/* Region types. When regions overlap, the higher type wins */
+#define MEMORY_REGION_USABLE   1
+#define MEMORY_REGION_ACPI     2 /* ACPI tables, reclaimable once parsed */
+#define MEMORY_REGION_ACPI_NVS 3
+#define MEMORY_REGION_RESERVED 4
+#define MEMORY_REGION_MODULE   5 /* Boot modules and loader structures */
+#define MEMORY_REGION_KERNEL   6 /* Kernel image and boot page tables */
+
+#define MEMORY_REGION_MAX      64
+
+/* Regions that must be present in the identity mapping */
+#define MEMORY_REGION_MAPPED(type)              \
+  ((type) == MEMORY_REGION_USABLE ||            \
+   (type) == MEMORY_REGION_MODULE ||            \
+   (type) == MEMORY_REGION_KERNEL)
+
+/* Sorted, non-overlapping range [start, end) of physical memory */
+struct memory_region
+{
+  uint64_t start;
+  uint64_t end;
+  uint32_t type;
+};
+
+BOOT_FUNCTION (void boot_memory_regions_init (struct multiboot_info *));
+BOOT_FUNCTION (void boot_memory_region_add (uint64_t, uint64_t, uint32_t));
+BOOT_FUNCTION (const struct memory_region *boot_memory_region_table (unsigned int *));
+
+const struct memory_region *memory_region_table (unsigned int *);
+void i386_physmem_dump (void);
+
+#endif /* _ARCH_I386_PHYSMEM_H */
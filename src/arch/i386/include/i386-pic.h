@@ -0,0 +1,47 @@
+/*
+ *    i386-pic.h: 8259 programmable interrupt controller
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_PIC_H
+#define _ARCH_I386_PIC_H
+
+#include <i386-irq.h>
+
+#define PIC_MASTER_CMD   0x20
+#define PIC_MASTER_DATA  0x21
+#define PIC_SLAVE_CMD    0xa0
+#define PIC_SLAVE_DATA   0xa1
+
+#define PIC_ICW1_ICW4    0x01 /* ICW4 will be sent */
+#define PIC_ICW1_INIT    0x10
+#define PIC_ICW4_8086    0x01
+
+#define PIC_OCW3_READ_ISR 0x0b
+#define PIC_EOI          0x20
+
+#define PIC_CASCADE_IRQ  2    /* The slave is wired to this master input */
+#define PIC_IRQS         8    /* Per chip */
+
+/* Remap both PICs after the CPU exceptions and mask every input */
+void i386_pic_init (unsigned int);
+
+/* Mask every input, once something else delivers interrupts */
+void i386_pic_disable (void);
+
+extern const struct irq_controller i386_pic;
+
+#endif /* _ARCH_I386_PIC_H */
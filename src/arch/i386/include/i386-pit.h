@@ -0,0 +1,47 @@
+/*
+ *    i386-pit.h: 8253/8254 programmable interval timer
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_PIT_H
+#define _ARCH_I386_PIT_H
+
+#define PIT_FREQUENCY     1193182 /* Hz */
+#define PIT_IRQ           0       /* Channel 0 output */
+
+#define PIT_PORT_CHANNEL0 0x40
+#define PIT_PORT_CHANNEL2 0x42
+#define PIT_PORT_COMMAND  0x43
+
+/* Channel 2 gate and output live in the keyboard controller port B */
+#define PIT_PORT_GATE     0x61
+#define PIT_GATE_CHANNEL2 0x01
+#define PIT_GATE_SPEAKER  0x02
+#define PIT_OUT_CHANNEL2  0x20
+
+/* Command byte fields */
+#define PIT_CMD_CHANNEL0  0x00
+#define PIT_CMD_CHANNEL2  0x80
+#define PIT_CMD_LOHI      0x30 /* Access low byte, then high byte */
+#define PIT_CMD_MODE0     0x00 /* Interrupt on terminal count */
+#define PIT_CMD_MODE2     0x04 /* Rate generator */
+
+/* Busy-wait helpers for calibration: start a delay of MS milliseconds
+   (at most 54) and poll for its end */
+void i386_pit_delay_start (unsigned int);
+int  i386_pit_delay_expired (void);
+
+#endif /* _ARCH_I386_PIT_H */
@@ -30,6 +30,18 @@
   
 #define CR0_PAGING_ENABLED 0x80000000
 
+/* CR0 FPU control bits */
+#define CR0_MP             (1 << 1) /* WAIT honours TS */
+#define CR0_EM             (1 << 2) /* No FPU: every FPU instruction traps */
+#define CR0_TS             (1 << 3) /* Task switched: next FPU use raises #NM */
+#define CR0_NE             (1 << 5) /* Native FPU error reporting (#MF) */
+
+/* CR4 bits */
+#define CR4_PSE            (1 << 4) /* 4 MiB pages */
+#define CR4_PGE            (1 << 7) /* Global pages */
+#define CR4_OSFXSR         (1 << 9) /* FXSAVE/FXRSTOR and SSE enabled */
+#define CR4_OSXMMEXCPT     (1 << 10) /* SIMD exceptions raise #XM */
+
 /* Extended processor flags to use with EFLAGS */
 
 #define EFLAGS_CARRY     (1 <<  0)
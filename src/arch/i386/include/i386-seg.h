@@ -0,0 +1,105 @@
+/*
+ *    i386-seg.h: Segmentation (GDT and TSS)
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_SEG_H
+#define _ARCH_I386_SEG_H
+
+/* GDT slots */
+#define GDT_ENTRY_NULL         0
+#define GDT_ENTRY_KERNEL_CODE  1
+#define GDT_ENTRY_KERNEL_DATA  2
+#define GDT_ENTRY_USER_CODE    3
+#define GDT_ENTRY_USER_DATA    4
+#define GDT_ENTRY_TSS          5
+#define GDT_ENTRY_PERCPU       6
+#define GDT_ENTRIES            7
+
+#define GDT_SELECTOR(entry, rpl) (((entry) << 3) | (rpl))
+
+#define KERNEL_CODE_SELECTOR   GDT_SELECTOR (GDT_ENTRY_KERNEL_CODE, 0) /* 0x08 */
+#define KERNEL_DATA_SELECTOR   GDT_SELECTOR (GDT_ENTRY_KERNEL_DATA, 0) /* 0x10 */
+#define USER_CODE_SELECTOR     GDT_SELECTOR (GDT_ENTRY_USER_CODE,   3) /* 0x1b */
+#define USER_DATA_SELECTOR     GDT_SELECTOR (GDT_ENTRY_USER_DATA,   3) /* 0x23 */
+#define TSS_SELECTOR           GDT_SELECTOR (GDT_ENTRY_TSS,         0) /* 0x28 */
+#define PERCPU_SELECTOR        GDT_SELECTOR (GDT_ENTRY_PERCPU,      0) /* 0x30 */
+
+#define SELECTOR_RPL_MASK      3
+
+#ifndef ASM
+
+/* Access byte */
+#define GDT_ACCESS_PRESENT     0x80
+#define GDT_ACCESS_DPL(dpl)    ((dpl) << 5)
+#define GDT_ACCESS_SEGMENT     0x10 /* Code or data, as opposed to system */
+#define GDT_ACCESS_CODE        0x0a /* Executable, readable */
+#define GDT_ACCESS_DATA        0x02 /* Writable */
+#define GDT_ACCESS_TSS         0x09 /* 32-bit available TSS */
+
+/* Flags nibble */
+#define GDT_FLAGS_4K           0x08 /* Limit counts pages */
+#define GDT_FLAGS_32BIT        0x04
+
+struct gdt_entry
+{
+  uint16_t limit_low;
+  uint16_t base_low;
+  uint8_t  base_mid;
+  uint8_t  access;
+  uint8_t  flags_limit_high;
+  uint8_t  base_high;
+} __attribute__ ((packed));
+
+struct x86_tss
+{
+  uint32_t prev;
+  uint32_t esp0;
+  uint32_t ss0;
+  uint32_t esp1;
+  uint32_t ss1;
+  uint32_t esp2;
+  uint32_t ss2;
+  uint32_t cr3;
+  uint32_t eip;
+  uint32_t eflags;
+  uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+  uint32_t es, cs, ss, ds, fs, gs;
+  uint32_t ldt;
+  uint16_t trap;
+  uint16_t iomap_base;
+} __attribute__ ((packed));
+
+struct x86_table_register
+{
+  uint16_t limit;
+  uint32_t base;
+} __attribute__ ((packed));
+
+/* Load the GDT and TSS of the given CPU, and point %fs to its per-CPU
+   block (see i386-percpu.h). Each CPU calls it once, for itself. */
+void i386_gdt_init (unsigned int);
+
+/* Stack this CPU switches to when entering the kernel from userland */
+void i386_tss_set_kernel_stack (uint32_t);
+
+/* Where that stack is stored, for entry paths that must fetch it
+   themselves (SYSENTER) */
+uint32_t *i386_tss_kernel_stack_slot (void);
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_SEG_H */
@@ -24,7 +24,48 @@
 #define COM_PORT_3_IO 0x3e8
 #define COM_PORT_4_IO 0x2e8
 
+/* Register offsets */
+#define COM_REG_THR   0   /* Transmit holding register (DLAB = 0) */
+#define COM_REG_DLL   0   /* Divisor latch, low byte (DLAB = 1) */
+#define COM_REG_IER   1   /* Interrupt enable (DLAB = 0) */
+#define COM_REG_DLM   1   /* Divisor latch, high byte (DLAB = 1) */
+#define COM_REG_IIR   2   /* Interrupt identification (read) */
+#define COM_REG_FCR   2   /* FIFO control (write) */
+#define COM_REG_LCR   3
+#define COM_REG_MCR   4
+#define COM_REG_LSR   5
+
+#define COM_IER_THRE  0x02
+#define COM_IIR_MASK  0x0f
+#define COM_IIR_THRE  0x02
+#define COM_LSR_THRE  0x20
+
+#define COM_IRQ_1_3   4   /* COM1 and COM3 share IRQ 4 */
+#define COM_IRQ_2_4   3   /* COM2 and COM4 share IRQ 3 */
+
+#define COM_FIFO_SIZE 16  /* 16550A transmit FIFO */
+
+/* Divisor 1 gives the fastest rate. Anything else must divide it. The
+   rate can be chosen with baud=N in the kernel command line. */
+#define COM_MAX_BAUD        115200
+#define COM_DEFAULT_DIVISOR 3 /* 38400 baud */
+
+/* Per-port transmit ring. Must be a power of two. */
+#define COM_TX_RING_SIZE 4096
+
 int  i386_serial_putchar (uint16_t, char);
+int  i386_serial_write (uint16_t, const void *, size_t);
+
+/* Service a pending THRE interrupt on port INDEX, if any */
+void i386_serial_irq_handler (uint16_t);
+
+/* Synchronously send everything still queued, and stop queueing
+   from now on. Meant for halt and panic paths. */
+void i386_serial_flush (void);
+
 void i386_serial_init (void);
+
+/* Start draining from the THRE interrupt. Needs i386_irq_init. */
+void i386_serial_irq_init (void);
   
 #endif /* _ARCH_I386_SERIAL_H */
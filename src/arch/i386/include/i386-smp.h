@@ -0,0 +1,53 @@
+/*
+ *    i386-smp.h: Application processor start-up
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_SMP_H
+#define _ARCH_I386_SMP_H
+
+/* Where the real-mode trampoline is copied. Startup IPIs take the page
+   number as vector, so it must be page-aligned and below 1 MiB. */
+#define TRAMPOLINE_BASE      0x8000
+
+/* Room for the trampoline, and for what it overwrites in the meantime */
+#define TRAMPOLINE_MAX_SIZE  256
+
+#define SMP_AP_STACK_SIZE    (4 * PAGE_SIZE)
+
+/* Waits of the INIT-SIPI-SIPI sequence (Intel SDM, MP initialization) */
+#define SMP_INIT_DELAY_US    10000
+#define SMP_SIPI_DELAY_US    200
+#define SMP_ALIVE_TIMEOUT_US 100000
+
+#ifndef ASM
+
+extern char trampoline_start[];
+extern char trampoline_end[];
+
+/* What the trampoline loads before jumping to i386_ap_entry. They live
+   in .bootdata, which is reachable with paging off. */
+extern uint32_t ap_boot_cr0;
+extern uint32_t ap_boot_cr3;
+extern uint32_t ap_boot_cr4;
+extern uint32_t ap_boot_stack;
+
+/* Upper half entry of every application processor */
+void i386_ap_entry (void) __attribute__ ((noreturn));
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_SMP_H */
@@ -0,0 +1,58 @@
+/*
+ *    i386-syscall.h: System call entry
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_SYSCALL_H
+#define _ARCH_I386_SYSCALL_H
+
+/* Register ABI, shared by both entry paths:
+
+     EAX       call number on entry, result on return
+     EBX, ESI,
+     EDI, EBP  arguments 0 to 3, preserved unless the call returns
+               more values in them (IPC messages)
+     ECX, EDX  clobbered
+
+   With SYSENTER (only if CPUID reports SEP), userland must also load
+   ECX with its stack pointer and EDX with the return address, as the
+   instruction saves neither. Otherwise, INT $0x80 takes the same
+   arguments. Flags other than IF are not preserved by SYSENTER. */
+
+/* Words of scratch stack SYSENTER lands on before switching to the
+   current kernel stack */
+#define SYSENTER_STACK_WORDS 16
+
+/* EBX, ESI, EDI and EBP, in this order */
+#define SYSCALL_ARG_REGS     4
+
+#ifndef ASM
+
+typedef uintptr_t (*i386_syscall_handler_t) (uintptr_t, uintptr_t *);
+
+extern i386_syscall_handler_t i386_syscall_handler;
+
+/* Program the SYSENTER MSRs (if supported) and the INT gate */
+void i386_syscall_init (void);
+
+/* Just the MSRs, for the other CPUs */
+void i386_syscall_init_cpu (void);
+
+int  i386_syscall_sysenter_enabled (void);
+
+#endif /* !ASM */
+
+#endif /* _ARCH_I386_SYSCALL_H */
@@ -0,0 +1,28 @@
+/*
+ *    i386-tsc.h: Time stamp counter
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ARCH_I386_TSC_H
+#define _ARCH_I386_TSC_H
+
+/* Measured against the PIT on first use, which busy-waits for
+   TSC_CALIBRATION_MS. 0 if the measure made no sense. */
+#define TSC_CALIBRATION_MS 10
+
+uint32_t i386_tsc_khz (void);
+
+#endif /* _ARCH_I386_TSC_H */
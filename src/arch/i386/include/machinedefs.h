@@ -26,4 +26,14 @@
 
 #define PAGE_BITS 12
 
+#define CACHE_LINE_SIZE 64
+
+#define CPU_MAX 16
+
+/* Physical memory below this address is identity-mapped in kernel space */
+#define PHYS_DIRECT_MAP_LIMIT 0xd0000000
+
+#define PHYS_TO_VIRT(addr)    ((void *) (uintptr_t) (addr))
+#define VIRT_TO_PHYS(ptr)     ((uintptr_t) (ptr))
+
 #endif /* _ARCH_MACHINEDEFS_H */
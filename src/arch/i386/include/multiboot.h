@@ -139,6 +139,12 @@ typedef struct memory_map
 BOOT_FUNCTION (void got_multiboot (struct multiboot_info *));
 BOOT_FUNCTION (struct multiboot_info *multiboot_location (void));
 
+const char *kernel_command_line (void);
+
+/* Value of a NAME=VALUE option in the kernel command line, terminated
+   by a space or the end of the string. NULL if not present. */
+const char *kernel_command_line_option (const char *);
+
 #endif /* ! ASM */
 
 #endif /* _MULTIBOOT_H */
@@ -0,0 +1,128 @@
+/*
+ *    irq.c: Hardware interrupt requests
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <i386-apic.h>
+#include <i386-int.h>
+#include <i386-irq.h>
+#include <i386-pic.h>
+
+struct irq_action
+{
+  void (*handler) (unsigned int, void *);
+  void *data;
+};
+
+static struct irq_action irq_actions[IRQ_COUNT];
+
+static const struct irq_controller *irq_controller;
+
+/* Attaching is check-then-set: one CPU at a time. The controllers
+   serialize mask updates themselves. */
+static spin_t irq_lock = SPIN_UNLOCKED;
+
+static void
+irq_entry (struct x86_stack_frame *frame, void *data)
+{
+  unsigned int irq = (uintptr_t) data;
+  struct irq_action *action = &irq_actions[irq];
+
+  if (irq_controller->spurious != NULL && (irq_controller->spurious) (irq))
+    return;
+
+  if (action->handler != NULL)
+    (action->handler) (irq, action->data);
+
+  (irq_controller->eoi) (irq);
+}
+
+int
+__arch_irq_attach (unsigned int irq,
+                   void (*handler) (unsigned int, void *),
+                   void *data)
+{
+  uintptr_t flags;
+
+  if (irq >= IRQ_COUNT || handler == NULL)
+    return -1;
+
+  flags = spin_lock_irqsave (&irq_lock);
+
+  if (irq_actions[irq].handler != NULL)
+  {
+    spin_unlock_irqrestore (&irq_lock, flags);
+
+    return -1;
+  }
+
+  irq_actions[irq].data    = data;
+  irq_actions[irq].handler = handler;
+
+  (irq_controller->unmask) (irq);
+
+  spin_unlock_irqrestore (&irq_lock, flags);
+
+  return 0;
+}
+
+void
+__arch_irq_mask (unsigned int irq)
+{
+  if (irq >= IRQ_COUNT)
+    return;
+
+  (irq_controller->mask) (irq);
+}
+
+void
+__arch_irq_unmask (unsigned int irq)
+{
+  if (irq >= IRQ_COUNT)
+    return;
+
+  (irq_controller->unmask) (irq);
+}
+
+void
+i386_irq_init (void)
+{
+  unsigned int i;
+
+  /* Even if the APICs are used, the 8259s must be moved away from
+     the exception vectors: they may still raise spurious IRQs */
+  i386_pic_init (INT_VECTOR_IRQ_BASE);
+
+  if (i386_apic_init () == 0)
+    irq_controller = &i386_apic;
+  else
+    irq_controller = &i386_pic;
+
+  printf ("IRQ: using %s\n", irq_controller->name);
+
+  for (i = 0; i < IRQ_COUNT; ++i)
+    (void) i386_int_register (
+      INT_VECTOR_IRQ_BASE + i,
+      irq_entry,
+      (void *) (uintptr_t) i);
+}
@@ -0,0 +1,81 @@
+/*
+ *    kmap.c: Kernel mappings of arbitrary physical memory
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <spinlock.h>
+
+#include <stdlib.h>
+
+#include <i386-kmap.h>
+#include <i386-layout.h>
+#include <i386-regs.h>
+
+static uint32_t kmap_table[PAGE_SIZE / sizeof (uint32_t)]
+  __attribute__ ((aligned (PAGE_SIZE)));
+
+static unsigned int kmap_next_page;
+
+static spin_t kmap_lock = SPIN_UNLOCKED;
+
+void *
+i386_kmap (uintptr_t phys, size_t size, uint32_t flags)
+{
+  uint32_t *page_dir;
+  uint32_t first, pages, i;
+  uintptr_t virt;
+  uintptr_t lock_flags;
+
+  pages = __UNITS (phys - PAGE_START (phys) + size, PAGE_SIZE);
+
+  lock_flags = spin_lock_irqsave (&kmap_lock);
+
+  if (pages > KMAP_SIZE / PAGE_SIZE - kmap_next_page)
+  {
+    spin_unlock_irqrestore (&kmap_lock, lock_flags);
+
+    return NULL;
+  }
+
+  /* The window's directory entry is set on first use */
+  if (kmap_next_page == 0)
+  {
+    GET_REGISTER ("%cr3", page_dir);
+
+    page_dir = (uint32_t *) PHYS_TO_VIRT (page_dir);
+
+    page_dir[KMAP_BASE >> PAGE_LARGE_BITS] =
+      ((uint32_t) kmap_table - KERNEL_BASE) | PAGE_TABLE_DFL_FLAGS;
+  }
+
+  first = kmap_next_page;
+  kmap_next_page += pages;
+
+  for (i = 0; i < pages; ++i)
+  {
+    virt = KMAP_BASE + ((first + i) << PAGE_BITS);
+
+    kmap_table[first + i] = (PAGE_START (phys) + (i << PAGE_BITS))
+      | PAGE_TABLE_DFL_FLAGS | PAGE_FLAG_GLOBAL | flags;
+
+    __asm__ __volatile__ ("invlpg (%0)" :: "r" (virt) : "memory");
+  }
+
+  spin_unlock_irqrestore (&kmap_lock, lock_flags);
+
+  return (void *) (KMAP_BASE + (first << PAGE_BITS) + (phys - PAGE_START (phys)));
+}
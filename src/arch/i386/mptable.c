@@ -0,0 +1,275 @@
+/*
+ *    mptable.c: Intel MultiProcessor Specification tables
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <i386-acpi.h>
+#include <i386-apic.h>
+#include <i386-kmap.h>
+
+#define MP_FLOATING_SIGNATURE "_MP_"
+#define MP_CONFIG_SIGNATURE   "PCMP"
+
+#define MP_FEATURE2_IMCR      0x80
+
+#define MP_ENTRY_PROCESSOR    0
+#define MP_ENTRY_BUS          1
+#define MP_ENTRY_IOAPIC       2
+#define MP_ENTRY_IO_INTERRUPT 3
+#define MP_ENTRY_LOCAL_INT    4
+
+#define MP_PROCESSOR_ENABLED  1
+#define MP_IOAPIC_ENABLED     1
+#define MP_INT_TYPE_INT       0 /* Vectored, as opposed to NMI, SMI or ExtINT */
+
+#define MP_MAX_BUSES          256
+
+struct mp_floating
+{
+  char     signature[4];
+  uint32_t config;
+  uint8_t  length;    /* In 16-byte units */
+  uint8_t  revision;
+  uint8_t  checksum;
+  uint8_t  features[5];
+} __attribute__ ((packed));
+
+struct mp_config
+{
+  char     signature[4];
+  uint16_t length;
+  uint8_t  revision;
+  uint8_t  checksum;
+  char     oem_id[8];
+  char     product_id[12];
+  uint32_t oem_table;
+  uint16_t oem_table_size;
+  uint16_t entry_count;
+  uint32_t lapic;
+  uint16_t ext_length;
+  uint8_t  ext_checksum;
+  uint8_t  reserved;
+} __attribute__ ((packed));
+
+struct mp_processor
+{
+  uint8_t  type;
+  uint8_t  apic_id;
+  uint8_t  apic_version;
+  uint8_t  flags;
+  uint32_t signature;
+  uint32_t features;
+  uint32_t reserved[2];
+} __attribute__ ((packed));
+
+struct mp_bus
+{
+  uint8_t type;
+  uint8_t id;
+  char    name[6];
+} __attribute__ ((packed));
+
+struct mp_ioapic
+{
+  uint8_t  type;
+  uint8_t  id;
+  uint8_t  version;
+  uint8_t  flags;
+  uint32_t address;
+} __attribute__ ((packed));
+
+struct mp_io_interrupt
+{
+  uint8_t  type;
+  uint8_t  int_type;
+  uint16_t flags;
+  uint8_t  bus;
+  uint8_t  bus_irq;
+  uint8_t  ioapic_id;
+  uint8_t  pin;
+} __attribute__ ((packed));
+
+static int
+mp_checksum (const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *) data;
+  uint8_t sum = 0;
+
+  while (size--)
+    sum += *bytes++;
+
+  return sum;
+}
+
+static const struct mp_floating *
+mp_scan (uintptr_t phys, size_t size)
+{
+  const uint8_t *area;
+  size_t off;
+
+  if ((area = i386_kmap (phys, size, 0)) == NULL)
+    return NULL;
+
+  for (off = 0; off + sizeof (struct mp_floating) <= size; off += 16)
+    if (memcmp (area + off, MP_FLOATING_SIGNATURE, 4) == 0 &&
+        mp_checksum (area + off, sizeof (struct mp_floating)) == 0)
+      return (const struct mp_floating *) (area + off);
+
+  return NULL;
+}
+
+static const struct mp_floating *
+mp_find (void)
+{
+  const uint16_t *ebda_segment;
+  const struct mp_floating *mp = NULL;
+
+  if ((ebda_segment = i386_kmap (ACPI_EBDA_SEGMENT_PTR, 2, 0)) != NULL &&
+      *ebda_segment != 0)
+    mp = mp_scan (*ebda_segment << 4, ACPI_EBDA_SEARCH_SIZE);
+
+  if (mp == NULL)
+    mp = mp_scan (ACPI_BIOS_AREA_START, ACPI_BIOS_AREA_END - ACPI_BIOS_AREA_START);
+
+  return mp;
+}
+
+/* IO interrupt entries name IO-APICs by ID */
+static struct ioapic *
+mp_ioapic_by_id (struct apic_config *config, uint8_t id)
+{
+  unsigned int i;
+
+  for (i = 0; i < config->ioapic_count; ++i)
+    if (config->ioapics[i].id == id)
+      return &config->ioapics[i];
+
+  return NULL;
+}
+
+int
+i386_mptable_parse (struct apic_config *config)
+{
+  const struct mp_floating *mp;
+  const struct mp_config *table;
+  const struct mp_processor *processor;
+  const struct mp_bus *bus;
+  const struct mp_ioapic *ioapic;
+  const struct mp_io_interrupt *irq;
+  struct ioapic *dest;
+  const uint8_t *p, *end;
+  uint8_t isa_bus[MP_MAX_BUSES / 8];
+  unsigned int i;
+
+  if ((mp = mp_find ()) == NULL)
+    return -1;
+
+  /* Default configurations (no table) are not supported */
+  if (mp->config == 0 || mp->features[0] != 0)
+    return -1;
+
+  if ((table = i386_kmap (mp->config, sizeof (struct mp_config), 0)) == NULL)
+    return -1;
+
+  if ((table = i386_kmap (mp->config, table->length, 0)) == NULL)
+    return -1;
+
+  if (memcmp (table->signature, MP_CONFIG_SIGNATURE, 4) != 0 ||
+      mp_checksum (table, table->length) != 0)
+    return -1;
+
+  config->lapic_phys = table->lapic;
+  config->has_imcr   = !!(mp->features[1] & MP_FEATURE2_IMCR);
+
+  memset (isa_bus, 0, sizeof (isa_bus));
+
+  /* Two passes: interrupt entries refer to buses and IO-APICs that may
+     be listed after them */
+  for (i = 0; i < 2; ++i)
+  {
+    p   = (const uint8_t *) (table + 1);
+    end = (const uint8_t *) table + table->length;
+
+    while (p < end)
+    {
+      switch (*p)
+      {
+        case MP_ENTRY_PROCESSOR:
+          processor = (const struct mp_processor *) p;
+
+          if (i == 0 && (processor->flags & MP_PROCESSOR_ENABLED))
+            i386_apic_config_add_cpu (config, processor->apic_id);
+
+          p += sizeof (struct mp_processor);
+          break;
+
+        case MP_ENTRY_BUS:
+          bus = (const struct mp_bus *) p;
+
+          if (i == 0 && memcmp (bus->name, "ISA", 3) == 0)
+            isa_bus[bus->id >> 3] |= 1 << (bus->id & 7);
+
+          p += sizeof (struct mp_bus);
+          break;
+
+        case MP_ENTRY_IOAPIC:
+          ioapic = (const struct mp_ioapic *) p;
+
+          if (i == 0 && (ioapic->flags & MP_IOAPIC_ENABLED))
+            (void) i386_apic_config_add_ioapic (
+              config,
+              ioapic->id,
+              ioapic->address,
+              APIC_GSI_AUTO);
+
+          p += sizeof (struct mp_ioapic);
+          break;
+
+        case MP_ENTRY_IO_INTERRUPT:
+          irq = (const struct mp_io_interrupt *) p;
+
+          if (i == 1 &&
+              irq->int_type == MP_INT_TYPE_INT &&
+              (isa_bus[irq->bus >> 3] & (1 << (irq->bus & 7))) &&
+              irq->bus_irq < IRQ_COUNT &&
+              (dest = mp_ioapic_by_id (config, irq->ioapic_id)) != NULL)
+            i386_apic_config_set_isa_irq (
+              config,
+              irq->bus_irq,
+              dest->gsi_base + irq->pin,
+              irq->flags);
+
+          p += sizeof (struct mp_io_interrupt);
+          break;
+
+        case MP_ENTRY_LOCAL_INT:
+          p += sizeof (struct mp_io_interrupt);
+          break;
+
+        default:
+          /* Unknown entry, its size cannot be known */
+          p = end;
+      }
+    }
+  }
+
+  return 0;
+}
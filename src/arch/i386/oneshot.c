@@ -0,0 +1,184 @@
+/*
+ *    oneshot.c: One-shot timer interrupt (local APIC timer or PIT)
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <i386-apic.h>
+#include <i386-int.h>
+#include <i386-io.h>
+#include <i386-pit.h>
+#include <i386-tsc.h>
+
+#define ONESHOT_CALIBRATION_MS 10
+
+#define LAPIC_TIMER_DIVIDE_16  0x03
+
+static void (*oneshot_handler) (void);
+
+static int oneshot_lapic;
+
+/* Timer ticks per TSC cycle, in 32.32 fixed point. Converting a
+   deadline is then a multiply and a shift. */
+static uint64_t oneshot_mult;
+
+static uint32_t oneshot_max_ticks;
+
+static uint32_t
+oneshot_ticks (uint64_t deadline)
+{
+  uint64_t now = __arch_cycles ();
+  uint64_t delta;
+  uint64_t ticks;
+
+  if (deadline <= now)
+    return 1;
+
+  delta = deadline - now;
+
+  /* Too far away: fire early, the handler will program the rest */
+  if (delta >> 32)
+    return oneshot_max_ticks;
+
+  ticks = (delta * oneshot_mult) >> 32;
+
+  if (ticks == 0)
+    return 1;
+
+  return ticks > oneshot_max_ticks ? oneshot_max_ticks : ticks;
+}
+
+void
+__arch_timer_set_deadline (uint64_t deadline)
+{
+  uint32_t ticks;
+
+  if (oneshot_lapic)
+    i386_lapic_write (
+      LAPIC_REG_TIMER_INITIAL,
+      deadline != 0 ? oneshot_ticks (deadline) : 0);
+  else
+  {
+    /* In mode 0, writing the command alone stops the count */
+    outportb (PIT_PORT_COMMAND, PIT_CMD_CHANNEL0 | PIT_CMD_LOHI | PIT_CMD_MODE0);
+
+    if (deadline != 0)
+    {
+      ticks = oneshot_ticks (deadline);
+
+      outportb (PIT_PORT_CHANNEL0, ticks & 0xff);
+      outportb (PIT_PORT_CHANNEL0, ticks >> 8);
+    }
+  }
+}
+
+static void
+oneshot_lapic_interrupt (struct x86_stack_frame *frame, void *data)
+{
+  i386_lapic_write (LAPIC_REG_EOI, 0);
+
+  (oneshot_handler) ();
+}
+
+static void
+oneshot_pit_interrupt (unsigned int irq, void *data)
+{
+  (oneshot_handler) ();
+}
+
+/* Ticks of the local APIC timer in ONESHOT_CALIBRATION_MS milliseconds */
+static uint32_t
+oneshot_lapic_calibrate (void)
+{
+  uint32_t remaining;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  i386_lapic_write (LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+  i386_lapic_write (LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | INT_VECTOR_TIMER);
+
+  i386_pit_delay_start (ONESHOT_CALIBRATION_MS);
+  i386_lapic_write (LAPIC_REG_TIMER_INITIAL, 0xffffffff);
+
+  while (!i386_pit_delay_expired ());
+
+  remaining = i386_lapic_read (LAPIC_REG_TIMER_CURRENT);
+
+  i386_lapic_write (LAPIC_REG_TIMER_INITIAL, 0);
+
+  __arch_irq_restore (flags);
+
+  return 0xffffffff - remaining;
+}
+
+void
+i386_lapic_timer_init_cpu (void)
+{
+  if (!oneshot_lapic)
+    return;
+
+  /* Same bus clock everywhere: the boot CPU's calibration holds */
+  i386_lapic_write (LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+  i386_lapic_write (LAPIC_REG_LVT_TIMER, INT_VECTOR_TIMER); /* One-shot */
+}
+
+void
+__arch_timer_init (void (*handler) (void))
+{
+  uint32_t tsc_khz = i386_tsc_khz ();
+  uint32_t timer_khz;
+
+  oneshot_handler = handler;
+
+  if (i386_apic_enabled ())
+  {
+    oneshot_lapic     = 1;
+    oneshot_max_ticks = 0xffffffff;
+
+    timer_khz = oneshot_lapic_calibrate () / ONESHOT_CALIBRATION_MS;
+
+    (void) i386_int_register (INT_VECTOR_TIMER, oneshot_lapic_interrupt, NULL);
+
+    i386_lapic_write (LAPIC_REG_LVT_TIMER, INT_VECTOR_TIMER); /* One-shot */
+  }
+  else
+  {
+    oneshot_max_ticks = 0xffff;
+
+    timer_khz = PIT_FREQUENCY / 1000;
+
+    __arch_timer_set_deadline (0);
+
+    (void) __arch_irq_attach (PIT_IRQ, oneshot_pit_interrupt, NULL);
+  }
+
+  oneshot_mult = ((uint64_t) timer_khz << 32) / tsc_khz;
+
+  /* The timer would be faster than the TSC: keep the product in range */
+  if (oneshot_mult >> 32)
+    oneshot_mult = 0xffffffff;
+
+  printf ("Timer: %s one-shot at %u kHz (TSC at %u kHz)\n",
+          oneshot_lapic ? "local APIC" : "PIT",
+          timer_khz,
+          tsc_khz);
+}
@@ -0,0 +1,273 @@
+/*
+ *    physmem.c: Physical memory discovery
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+
+#include <i386-layout.h>
+#include <i386-physmem.h>
+
+#include <multiboot.h>
+
+/* Memory below 1 MiB is left alone (BIOS data, multiboot structures...) */
+#define PHYSMEM_LOW_LIMIT 0x100000
+
+/* Symbols provided by linker */
+extern int boot_start;
+extern int kernel_end;
+
+/* Everything we have been told about physical memory, as is */
+BOOT_SYMBOL (static struct memory_region raw_regions[MEMORY_REGION_MAX]);
+BOOT_SYMBOL (static unsigned int raw_region_count);
+
+/* The sanitized table: sorted, clipped and merged */
+BOOT_SYMBOL (static struct memory_region regions[MEMORY_REGION_MAX]);
+BOOT_SYMBOL (static unsigned int region_count);
+
+BOOT_FUNCTION (static void boot_memory_regions_sanitize (void));
+BOOT_FUNCTION (static void boot_memory_region_append (uint64_t, uint64_t, uint32_t));
+
+static void
+boot_memory_region_append (uint64_t start, uint64_t end, uint32_t type)
+{
+  if (start >= end || raw_region_count == MEMORY_REGION_MAX)
+    return;
+
+  raw_regions[raw_region_count].start = start;
+  raw_regions[raw_region_count].end   = end;
+  raw_regions[raw_region_count].type  = type;
+
+  ++raw_region_count;
+}
+
+/* Rebuild the table from the raw region list. Every boundary is a
+   potential region change: for each elementary interval between two
+   consecutive boundaries, the highest type covering it wins. Adjacent
+   intervals of the same type are merged and uncovered ones are holes. */
+static void
+boot_memory_regions_sanitize (void)
+{
+  uint64_t points[2 * MEMORY_REGION_MAX];
+  uint64_t tmp, lo, hi;
+  unsigned int point_count;
+  unsigned int i, j;
+  uint32_t type;
+
+  point_count = 0;
+
+  for (i = 0; i < raw_region_count; ++i)
+  {
+    points[point_count++] = raw_regions[i].start;
+    points[point_count++] = raw_regions[i].end;
+  }
+
+  /* Insertion sort, we only have a few dozens of them */
+  for (i = 1; i < point_count; ++i)
+  {
+    tmp = points[i];
+
+    for (j = i; j > 0 && points[j - 1] > tmp; --j)
+      points[j] = points[j - 1];
+
+    points[j] = tmp;
+  }
+
+  region_count = 0;
+
+  for (i = 0; i + 1 < point_count; ++i)
+  {
+    lo = points[i];
+    hi = points[i + 1];
+
+    if (lo == hi)
+      continue;
+
+    type = 0;
+
+    for (j = 0; j < raw_region_count; ++j)
+      if (raw_regions[j].start <= lo && raw_regions[j].end >= hi && raw_regions[j].type > type)
+        type = raw_regions[j].type;
+
+    if (type == 0)
+      continue;
+
+    if (region_count > 0 &&
+        regions[region_count - 1].type == type &&
+        regions[region_count - 1].end == lo)
+      regions[region_count - 1].end = hi;
+    else if (region_count < MEMORY_REGION_MAX)
+    {
+      regions[region_count].start = lo;
+      regions[region_count].end   = hi;
+      regions[region_count].type  = type;
+
+      ++region_count;
+    }
+  }
+}
+
+void
+boot_memory_regions_init (struct multiboot_info *mbi)
+{
+  struct memory_map *mmap_info;
+  struct module *mod;
+  unsigned int i;
+  uint32_t p;
+  uint64_t base;
+  uint32_t type;
+
+  raw_region_count = 0;
+
+  /* Entries may be bigger than memory_map_t, the size field tells */
+  for (p = mbi->mmap_addr;
+       p < mbi->mmap_addr + mbi->mmap_length;
+       p += mmap_info->size + sizeof (mmap_info->size))
+  {
+    mmap_info = (struct memory_map *) p;
+
+    base = mmap_info->base_addr_low | ((uint64_t) mmap_info->base_addr_high << 32);
+
+    switch (mmap_info->type)
+    {
+      case 1:
+        type = MEMORY_REGION_USABLE;
+        break;
+
+      case 3:
+        type = MEMORY_REGION_ACPI;
+        break;
+
+      case 4:
+        type = MEMORY_REGION_ACPI_NVS;
+        break;
+
+      default:
+        type = MEMORY_REGION_RESERVED;
+    }
+
+    boot_memory_region_append (
+      base,
+      base + (mmap_info->length_low | ((uint64_t) mmap_info->length_high << 32)),
+      type);
+  }
+
+  boot_memory_region_append (
+    (uint32_t) &boot_start,
+    __ALIGN ((uint32_t) &kernel_end, PAGE_SIZE),
+    MEMORY_REGION_KERNEL);
+
+  /* Whatever the loader handed us stays out of the allocator: the
+     memory map, the module list and every module (the information
+     structure itself has been copied into the kernel image) */
+  boot_memory_region_append (
+    PAGE_START (mbi->mmap_addr),
+    __ALIGN (mbi->mmap_addr + mbi->mmap_length, PAGE_SIZE),
+    MEMORY_REGION_MODULE);
+
+  if (mbi->mods_count)
+  {
+    mod = (struct module *) mbi->mods_addr;
+
+    boot_memory_region_append (
+      PAGE_START ((uint32_t) mod),
+      __ALIGN ((uint32_t) &mod[mbi->mods_count], PAGE_SIZE),
+      MEMORY_REGION_MODULE);
+
+    for (i = 0; i < mbi->mods_count; ++i)
+      boot_memory_region_append (
+        PAGE_START (mod[i].mod_start),
+        __ALIGN (mod[i].mod_end, PAGE_SIZE),
+        MEMORY_REGION_MODULE);
+  }
+
+  boot_memory_regions_sanitize ();
+}
+
+void
+boot_memory_region_add (uint64_t start, uint64_t end, uint32_t type)
+{
+  boot_memory_region_append (start, end, type);
+
+  boot_memory_regions_sanitize ();
+}
+
+const struct memory_region *
+boot_memory_region_table (unsigned int *count)
+{
+  *count = region_count;
+
+  return regions;
+}
+
+const struct memory_region *
+memory_region_table (unsigned int *count)
+{
+  *count = region_count;
+
+  return regions;
+}
+
+void
+i386_physmem_dump (void)
+{
+  static const char *type_names[] =
+  {
+    "?", "usable", "ACPI", "ACPI NVS", "reserved", "module", "kernel"
+  };
+  unsigned int i;
+
+  printf ("Physical memory map:\n");
+
+  for (i = 0; i < region_count; ++i)
+    printf (
+      "  %016llx-%016llx %s\n",
+      regions[i].start,
+      regions[i].end - 1,
+      type_names[regions[i].type]);
+}
+
+void
+__arch_enum_free_memory (void (*func) (uintptr_t, uintptr_t, void *), void *data)
+{
+  uint64_t start, end;
+  unsigned int i;
+
+  for (i = 0; i < region_count; ++i)
+  {
+    if (regions[i].type != MEMORY_REGION_USABLE)
+      continue;
+
+    start = regions[i].start;
+    end   = regions[i].end;
+
+    /* Only identity-mapped memory is usable by the kernel */
+    if (start < PHYSMEM_LOW_LIMIT)
+      start = PHYSMEM_LOW_LIMIT;
+
+    if (end > PHYS_DIRECT_MAP_LIMIT)
+      end = PHYS_DIRECT_MAP_LIMIT;
+
+    start = __ALIGN (start, PAGE_SIZE);
+    end   = PAGE_START (end);
+
+    if (start < end)
+      (func) (start, end, data);
+  }
+}
@@ -0,0 +1,156 @@
+/*
+ *    pic.c: 8259 programmable interrupt controller
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <spinlock.h>
+
+#include <i386-io.h>
+#include <i386-pic.h>
+
+/* Cascade input is always open, so slave IRQs only depend on their own mask */
+static uint16_t pic_masks = 0xffff & ~(1 << PIC_CASCADE_IRQ);
+
+/* Mask updates are read-modify-write: one CPU at a time */
+static spin_t pic_lock = SPIN_UNLOCKED;
+
+static inline void
+pic_io_wait (void)
+{
+  /* Unused port, gives old PICs time to settle between ICWs */
+  outportb (0x80, 0);
+}
+
+static void
+pic_write_masks (void)
+{
+  outportb (PIC_MASTER_DATA, pic_masks & 0xff);
+  outportb (PIC_SLAVE_DATA, pic_masks >> 8);
+}
+
+static void
+pic_mask (unsigned int irq)
+{
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&pic_lock);
+
+  pic_masks |= 1 << irq;
+
+  pic_write_masks ();
+
+  spin_unlock_irqrestore (&pic_lock, flags);
+}
+
+static void
+pic_unmask (unsigned int irq)
+{
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&pic_lock);
+
+  pic_masks &= ~(1 << irq);
+
+  pic_write_masks ();
+
+  spin_unlock_irqrestore (&pic_lock, flags);
+}
+
+static void
+pic_eoi (unsigned int irq)
+{
+  if (irq >= PIC_IRQS)
+    outportb (PIC_SLAVE_CMD, PIC_EOI);
+
+  outportb (PIC_MASTER_CMD, PIC_EOI);
+}
+
+/* IRQ 7 and 15 are what a PIC reports when the line went away before
+   the CPU acknowledged it. The in-service register tells the truth. */
+static int
+pic_spurious (unsigned int irq)
+{
+  if (irq == 7)
+  {
+    outportb (PIC_MASTER_CMD, PIC_OCW3_READ_ISR);
+
+    return !(inportb (PIC_MASTER_CMD) & 0x80);
+  }
+  else if (irq == 15)
+  {
+    outportb (PIC_SLAVE_CMD, PIC_OCW3_READ_ISR);
+
+    if (inportb (PIC_SLAVE_CMD) & 0x80)
+      return 0;
+
+    /* The master did see the cascade line, though */
+    outportb (PIC_MASTER_CMD, PIC_EOI);
+
+    return 1;
+  }
+
+  return 0;
+}
+
+void
+i386_pic_disable (void)
+{
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&pic_lock);
+
+  pic_masks = 0xffff;
+
+  pic_write_masks ();
+
+  spin_unlock_irqrestore (&pic_lock, flags);
+}
+
+const struct irq_controller i386_pic =
+{
+  .name     = "8259 PIC",
+  .mask     = pic_mask,
+  .unmask   = pic_unmask,
+  .eoi      = pic_eoi,
+  .spurious = pic_spurious
+};
+
+void
+i386_pic_init (unsigned int vector_base)
+{
+  outportb (PIC_MASTER_CMD, PIC_ICW1_INIT | PIC_ICW1_ICW4);
+  pic_io_wait ();
+  outportb (PIC_SLAVE_CMD, PIC_ICW1_INIT | PIC_ICW1_ICW4);
+  pic_io_wait ();
+
+  outportb (PIC_MASTER_DATA, vector_base);
+  pic_io_wait ();
+  outportb (PIC_SLAVE_DATA, vector_base + PIC_IRQS);
+  pic_io_wait ();
+
+  outportb (PIC_MASTER_DATA, 1 << PIC_CASCADE_IRQ);
+  pic_io_wait ();
+  outportb (PIC_SLAVE_DATA, PIC_CASCADE_IRQ);
+  pic_io_wait ();
+
+  outportb (PIC_MASTER_DATA, PIC_ICW4_8086);
+  pic_io_wait ();
+  outportb (PIC_SLAVE_DATA, PIC_ICW4_8086);
+  pic_io_wait ();
+
+  pic_write_masks ();
+}
@@ -0,0 +1,44 @@
+/*
+ *    pit.c: 8253/8254 programmable interval timer
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <i386-io.h>
+#include <i386-pit.h>
+
+/* Channel 2 is used because its output can be polled and it does not
+   raise interrupts. MS must be below 55. */
+void
+i386_pit_delay_start (unsigned int ms)
+{
+  uint32_t latch = PIT_FREQUENCY * ms / 1000;
+
+  outportb (
+    PIT_PORT_GATE,
+    (inportb (PIT_PORT_GATE) & ~PIT_GATE_SPEAKER) | PIT_GATE_CHANNEL2);
+
+  outportb (PIT_PORT_COMMAND, PIT_CMD_CHANNEL2 | PIT_CMD_LOHI | PIT_CMD_MODE0);
+  outportb (PIT_PORT_CHANNEL2, latch & 0xff);
+  outportb (PIT_PORT_CHANNEL2, latch >> 8);
+}
+
+int
+i386_pit_delay_expired (void)
+{
+  return inportb (PIT_PORT_GATE) & PIT_OUT_CHANNEL2;
+}
@@ -17,28 +17,53 @@
  */
 
 #include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdlib.h>
 
 #include <i386-io.h>
+#include <i386-layout.h>
 #include <i386-serial.h>
 
-static uint16_t com_io_ports[] = {COM_PORT_1_IO, COM_PORT_2_IO, COM_PORT_3_IO, COM_PORT_4_IO};
+#include <multiboot.h>
+
+struct com_port
+{
+  uint16_t     base;
+  spin_t       lock;
+  unsigned int head;   /* Next byte to enqueue */
+  unsigned int tail;   /* Next byte to send */
+  uint8_t      ring[COM_TX_RING_SIZE];
+};
+
+static struct com_port com_ports[] =
+{
+  {COM_PORT_1_IO}, {COM_PORT_2_IO}, {COM_PORT_3_IO}, {COM_PORT_4_IO}
+};
+
+static uint16_t com_divisor = COM_DEFAULT_DIVISOR;
+
+/* Set once the system is going down: from then on, bytes go straight
+   to the wire, bypassing rings and interrupts */
+static int com_sync = 0;
 
 void
 com_port_init (uint16_t base)
 {
-  outportb (base + 1, 0x00);    /* Disable all interrupts */
-  outportb (base + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
-  outportb (base + 0, 0x03);    /* Set divisor to 3 (lo byte) 38400 baud */
-  outportb (base + 1, 0x00);    /*                  (hi byte) */
-  outportb (base + 3, 0x03);    /* 8 bits, no parity, one stop bit */
-  outportb (base + 2, 0xC7);    /* Enable FIFO, clear them, with 14-byte threshold */
-  outportb (base + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
+  outportb (base + COM_REG_IER, 0x00);  /* Disable all interrupts */
+  outportb (base + COM_REG_LCR, 0x80);  /* Enable DLAB (set baud rate divisor) */
+  outportb (base + COM_REG_DLL, com_divisor & 0xff);
+  outportb (base + COM_REG_DLM, com_divisor >> 8);
+  outportb (base + COM_REG_LCR, 0x03);  /* 8 bits, no parity, one stop bit */
+  outportb (base + COM_REG_FCR, 0xC7);  /* Enable FIFO, clear them, with 14-byte threshold */
+  outportb (base + COM_REG_MCR, 0x0B);  /* IRQs enabled, RTS/DSR set */
 }
 
 int
 com_transmit_empty (uint16_t base)
 {
-  return inportb (base + 5) & 0x20;
+  return inportb (base + COM_REG_LSR) & COM_LSR_THRE;
 }
  
 void
@@ -46,31 +71,190 @@ com_write (uint16_t base, char c)
 {
   while (!com_transmit_empty (base));
  
-  outportb (base, c);
+  outportb (base + COM_REG_THR, c);
+}
+
+static inline unsigned int
+com_ring_used (const struct com_port *port)
+{
+  return port->head - port->tail;
+}
+
+/* THRE means the whole transmit FIFO is empty, so it can take a full
+   burst of COM_FIFO_SIZE bytes without polling in between. Must be
+   called with the port lock held. */
+static void
+com_port_burst (struct com_port *port)
+{
+  unsigned int n = 0;
+
+  /* Still sending the previous burst: make sure its end is signalled,
+     the last burst may have turned the interrupt off */
+  if (!com_transmit_empty (port->base))
+  {
+    if (com_ring_used (port) > 0)
+      outportb (port->base + COM_REG_IER, COM_IER_THRE);
+
+    return;
+  }
+
+  while (n++ < COM_FIFO_SIZE && com_ring_used (port) > 0)
+    outportb (
+      port->base + COM_REG_THR,
+      port->ring[port->tail++ & (COM_TX_RING_SIZE - 1)]);
+
+  /* Ask for an interrupt when the FIFO empties only if there is
+     something left to send */
+  outportb (
+    port->base + COM_REG_IER,
+    com_ring_used (port) > 0 ? COM_IER_THRE : 0);
+}
+
+static void
+com_port_drain (struct com_port *port)
+{
+  while (com_ring_used (port) > 0)
+    com_write (port->base, port->ring[port->tail++ & (COM_TX_RING_SIZE - 1)]);
+
+  outportb (port->base + COM_REG_IER, 0);
 }
 
 int
-i386_serial_putchar (uint16_t port, char byte)
+i386_serial_write (uint16_t index, const void *buf, size_t size)
 {
-  if (port >= 4)
+  const uint8_t *bytes = (const uint8_t *) buf;
+  struct com_port *port;
+  uintptr_t flags;
+
+  if (index >= 4)
     return -1;
 
-  com_write (com_io_ports[port], byte);
-  
+  port = &com_ports[index];
+
+  if (com_sync)
+  {
+    while (size--)
+      com_write (port->base, *bytes++);
+
+    return 0;
+  }
+
+  flags = spin_lock_irqsave (&port->lock);
+
+  while (size--)
+  {
+    /* Ring is full: wait for the FIFO to make room instead of dropping */
+    while (com_ring_used (port) == COM_TX_RING_SIZE)
+    {
+      while (!com_transmit_empty (port->base));
+
+      com_port_burst (port);
+    }
+
+    port->ring[port->head++ & (COM_TX_RING_SIZE - 1)] = *bytes++;
+  }
+
+  com_port_burst (port);
+
+  spin_unlock_irqrestore (&port->lock, flags);
+
   return 0;
 }
 
+int
+i386_serial_putchar (uint16_t index, char byte)
+{
+  return i386_serial_write (index, &byte, 1);
+}
+
+void
+i386_serial_irq_handler (uint16_t index)
+{
+  struct com_port *port;
+
+  if (index >= 4)
+    return;
+
+  port = &com_ports[index];
+
+  spin_lock (&port->lock);
+
+  /* Reading IIR acknowledges a pending THRE interrupt */
+  if ((inportb (port->base + COM_REG_IIR) & COM_IIR_MASK) == COM_IIR_THRE)
+    com_port_burst (port);
+
+  spin_unlock (&port->lock);
+}
+
+void
+i386_serial_flush (void)
+{
+  unsigned int i;
+  int locked;
+
+  com_sync = 1;
+
+  /* We may be flushing from a failure path with the lock already held.
+     Send everything anyway: losing the last words of a dying kernel
+     is worse than a garbled line. */
+  for (i = 0; i < 4; ++i)
+  {
+    locked = spin_trylock (&com_ports[i].lock);
+
+    com_port_drain (&com_ports[i]);
+
+    if (locked)
+      spin_unlock (&com_ports[i].lock);
+  }
+}
+
 int
 serial_port_count (void)
 {
   return 4;
 }
 
+static void
+com_parse_baud (void)
+{
+  const char *value;
+  unsigned long baud = 0;
+
+  if ((value = kernel_command_line_option ("baud")) == NULL)
+    return;
+
+  /* strtoul drags musl's FILE machinery in, parse it by hand */
+  while (*value >= '0' && *value <= '9' && baud <= COM_MAX_BAUD)
+    baud = 10 * baud + *value++ - '0';
+
+  if (baud == 0 || baud > COM_MAX_BAUD || COM_MAX_BAUD % baud != 0)
+    return;
+
+  com_divisor = COM_MAX_BAUD / baud;
+}
+
+/* Each IRQ line is shared by two ports */
+static void
+com_irq_handler (unsigned int irq, void *data)
+{
+  i386_serial_irq_handler (irq == COM_IRQ_1_3 ? 0 : 1);
+  i386_serial_irq_handler (irq == COM_IRQ_1_3 ? 2 : 3);
+}
+
 void
 i386_serial_init (void)
 {
-  com_port_init (COM_PORT_1_IO);
-  com_port_init (COM_PORT_2_IO);
-  com_port_init (COM_PORT_3_IO);
-  com_port_init (COM_PORT_4_IO);
+  unsigned int i;
+
+  com_parse_baud ();
+
+  for (i = 0; i < 4; ++i)
+    com_port_init (com_ports[i].base);
+}
+
+void
+i386_serial_irq_init (void)
+{
+  (void) __arch_irq_attach (COM_IRQ_1_3, com_irq_handler, NULL);
+  (void) __arch_irq_attach (COM_IRQ_2_4, com_irq_handler, NULL);
 }
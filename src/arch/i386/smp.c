@@ -0,0 +1,215 @@
+/*
+ *    smp.c: Application processor start-up
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <atomic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <i386-apic.h>
+#include <i386-fpu.h>
+#include <i386-int.h>
+#include <i386-layout.h>
+#include <i386-percpu.h>
+#include <i386-regs.h>
+#include <i386-seg.h>
+#include <i386-smp.h>
+#include <i386-syscall.h>
+#include <i386-tsc.h>
+
+#include <multiboot.h>
+
+BOOT_SYMBOL (uint32_t ap_boot_cr0);
+BOOT_SYMBOL (uint32_t ap_boot_cr3);
+BOOT_SYMBOL (uint32_t ap_boot_cr4);
+BOOT_SYMBOL (uint32_t ap_boot_stack);
+
+static void (*smp_entry) (void);
+
+static volatile unsigned int smp_cpu_count = 1;
+
+/* CPUs are started one at a time: this is the one being started, and
+   it sets smp_ap_alive once it no longer needs the trampoline */
+static unsigned int smp_ap_id;
+static volatile int smp_ap_alive;
+
+static void
+smp_udelay (uint32_t us)
+{
+  uint64_t end = __arch_cycles () + (uint64_t) i386_tsc_khz () * us / 1000;
+
+  while (__arch_cycles () < end)
+    a_spin ();
+}
+
+static void
+smp_kick_interrupt (struct x86_stack_frame *frame, void *data)
+{
+  /* Nothing else to do: waking up and going through the preemption
+     point was the whole point */
+  i386_lapic_write (LAPIC_REG_EOI, 0);
+}
+
+void
+__arch_cpu_kick (unsigned int cpu)
+{
+  if (cpu < smp_cpu_count && cpu != __arch_cpu_id ())
+    i386_lapic_send_ipi (i386_cpu_of (cpu)->apic_id, INT_VECTOR_KICK);
+}
+
+unsigned int
+__arch_cpu_count (void)
+{
+  return smp_cpu_count;
+}
+
+/* Per-CPU halves of machine_init. Everything global (IDT contents,
+   patched alternatives, timer calibration) was done by the boot CPU,
+   and all CPUs are assumed to be alike. */
+void
+i386_ap_entry (void)
+{
+  i386_gdt_init (smp_ap_id);
+
+  i386_idt_load ();
+
+  i386_fpu_init_cpu ();
+
+  i386_lapic_init_cpu ();
+
+  i386_lapic_timer_init_cpu ();
+
+  i386_syscall_init_cpu ();
+
+  a_store (&smp_ap_alive, 1);
+
+  (smp_entry) ();
+
+  for (;;)
+    __asm__ __volatile__ ("hlt");
+}
+
+/* INIT, then two startup IPIs, as the MP specification says. Only
+   integrated APICs are supported: the 82489DX would need the BIOS warm
+   reset vector instead. */
+static int
+smp_start_cpu (unsigned int id, uint8_t apic_id)
+{
+  unsigned int i;
+  void *stack;
+
+  if ((stack = malloc (SMP_AP_STACK_SIZE)) == NULL)
+    return -1;
+
+  i386_cpu_of (id)->apic_id = apic_id;
+
+  smp_ap_id     = id;
+  smp_ap_alive  = 0;
+  ap_boot_stack = (uint32_t) stack + SMP_AP_STACK_SIZE;
+
+  i386_lapic_send_ipi (
+    apic_id,
+    LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+
+  smp_udelay (SMP_INIT_DELAY_US);
+
+  for (i = 0; i < 2; ++i)
+  {
+    i386_lapic_send_ipi (
+      apic_id,
+      LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT | (TRAMPOLINE_BASE >> PAGE_BITS));
+
+    smp_udelay (SMP_SIPI_DELAY_US);
+  }
+
+  for (i = 0; i < SMP_ALIVE_TIMEOUT_US / 100 && !smp_ap_alive; ++i)
+    smp_udelay (100);
+
+  /* The stack is leaked on failure: the CPU may still wake up late */
+  return smp_ap_alive ? 0 : -1;
+}
+
+unsigned int
+__arch_smp_start (void (*entry) (void))
+{
+  const struct apic_config *config;
+  uint8_t saved[TRAMPOLINE_MAX_SIZE];
+  size_t size = trampoline_end - trampoline_start;
+  const char *option;
+  uint8_t bsp_apic_id;
+  unsigned int i;
+  int stuck = 0;
+
+  if ((option = kernel_command_line_option ("smp")) != NULL &&
+      strncmp (option, "off", 3) == 0)
+    return smp_cpu_count;
+
+  /* No local APIC, no IPIs */
+  if (!i386_apic_enabled ())
+    return smp_cpu_count;
+
+  config = i386_apic_config ();
+
+  bsp_apic_id = i386_lapic_id ();
+
+  i386_this_cpu ()->apic_id = bsp_apic_id;
+
+  if (config->cpu_count < 2 || size > sizeof (saved))
+    return smp_cpu_count;
+
+  smp_entry = entry;
+
+  (void) i386_int_register (INT_VECTOR_KICK, smp_kick_interrupt, NULL);
+
+  GET_REGISTER ("%cr0", ap_boot_cr0);
+  GET_REGISTER ("%cr3", ap_boot_cr3);
+  GET_REGISTER ("%cr4", ap_boot_cr4);
+
+  /* Low memory is not handed to the frame allocator, but firmware or
+     the boot loader may have left something there */
+  memcpy (saved, PHYS_TO_VIRT (TRAMPOLINE_BASE), size);
+  memcpy (PHYS_TO_VIRT (TRAMPOLINE_BASE), trampoline_start, size);
+
+  for (i = 0; i < config->cpu_count && smp_cpu_count < CPU_MAX; ++i)
+  {
+    if (config->cpu_apic_ids[i] == bsp_apic_id)
+      continue;
+
+    if (smp_start_cpu (smp_cpu_count, config->cpu_apic_ids[i]) != 0)
+    {
+      printf ("SMP: CPU with local APIC %u did not start\n",
+              config->cpu_apic_ids[i]);
+
+      /* It may still be running the trampoline */
+      stuck = 1;
+      break;
+    }
+
+    ++smp_cpu_count;
+  }
+
+  if (!stuck)
+    memcpy (PHYS_TO_VIRT (TRAMPOLINE_BASE), saved, size);
+
+  printf ("SMP: %u of %u CPU(s) online\n", smp_cpu_count, config->cpu_count);
+
+  return smp_cpu_count;
+}
@@ -0,0 +1,135 @@
+/*
+ *    syscall.c: System call entry
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <i386-cpuid.h>
+#include <i386-int.h>
+#include <i386-msr.h>
+#include <i386-seg.h>
+#include <i386-syscall.h>
+
+extern char sysenter_entry[];
+
+static uintptr_t syscall_not_ready (uintptr_t, uintptr_t *);
+
+i386_syscall_handler_t i386_syscall_handler = syscall_not_ready;
+
+/* MSR_SYSENTER_ESP cannot follow thread switches, so it points to
+   kernel_stack_slot, from which the entry stub fetches the real stack.
+   The words below give anything interrupting those two instructions
+   (NMI, debug traps) somewhere to push its frame. One per CPU, as each
+   has its own TSS. */
+static struct sysenter_area
+{
+  uint32_t  scratch[SYSENTER_STACK_WORDS];
+  uint32_t *kernel_stack_slot;
+}
+sysenter_areas[CPU_MAX] __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static int sysenter_enabled;
+
+static uintptr_t
+syscall_not_ready (uintptr_t nr, uintptr_t *args)
+{
+  return -ENOSYS;
+}
+
+static void
+syscall_int_handler (struct x86_stack_frame *frame, void *data)
+{
+  uintptr_t args[SYSCALL_ARG_REGS];
+
+  /* Entered through an interrupt gate, but system calls may run long */
+  __asm__ __volatile__ ("sti" ::: "memory");
+
+  args[0] = frame->regs.ebx;
+  args[1] = frame->regs.esi;
+  args[2] = frame->regs.edi;
+  args[3] = frame->regs.ebp;
+
+  frame->regs.eax = (i386_syscall_handler) (frame->regs.eax, args);
+
+  frame->regs.ebx = args[0];
+  frame->regs.esi = args[1];
+  frame->regs.edi = args[2];
+  frame->regs.ebp = args[3];
+}
+
+/* Early Pentium Pro steppings report SEP without implementing it */
+static int
+syscall_sysenter_supported (void)
+{
+  const struct cpu_features *cpu = i386_cpu_features ();
+
+  if (!i386_cpu_has (CPU_FEATURE_SEP) || !i386_cpu_has (CPU_FEATURE_MSR))
+    return 0;
+
+  return !(cpu->family == 6 && cpu->model < 3 && cpu->stepping < 3);
+}
+
+int
+i386_syscall_sysenter_enabled (void)
+{
+  return sysenter_enabled;
+}
+
+void
+__arch_syscall_init (i386_syscall_handler_t handler)
+{
+  i386_syscall_handler = handler;
+}
+
+void
+i386_syscall_init_cpu (void)
+{
+  struct sysenter_area *area = &sysenter_areas[__arch_cpu_id ()];
+
+  if (!sysenter_enabled)
+    return;
+
+  area->kernel_stack_slot = i386_tss_kernel_stack_slot ();
+
+  /* SYSEXIT derives the user selectors from this one (+16 and +24) */
+  wrmsr (MSR_SYSENTER_CS,  KERNEL_CODE_SELECTOR);
+  wrmsr (MSR_SYSENTER_ESP, (uint32_t) &area->kernel_stack_slot);
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+}
+
+void
+i386_syscall_init (void)
+{
+  (void) i386_int_register (INT_VECTOR_SYSCALL, syscall_int_handler, NULL);
+
+  i386_int_set_user (INT_VECTOR_SYSCALL);
+
+  if (!syscall_sysenter_supported ())
+  {
+    printf ("syscall: SYSENTER not supported, using INT $0x%x\n",
+            INT_VECTOR_SYSCALL);
+    return;
+  }
+
+  sysenter_enabled = 1;
+
+  i386_syscall_init_cpu ();
+}
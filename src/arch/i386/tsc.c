@@ -0,0 +1,56 @@
+/*
+ *    tsc.c: Time stamp counter
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <i386-pit.h>
+#include <i386-tsc.h>
+
+static uint32_t tsc_khz;
+
+/* See how far the TSC goes in TSC_CALIBRATION_MS milliseconds */
+static uint32_t
+tsc_calibrate (void)
+{
+  uint64_t start, end;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  i386_pit_delay_start (TSC_CALIBRATION_MS);
+
+  start = __arch_cycles ();
+
+  while (!i386_pit_delay_expired ());
+
+  end = __arch_cycles ();
+
+  __arch_irq_restore (flags);
+
+  return (end - start) / TSC_CALIBRATION_MS;
+}
+
+uint32_t
+i386_tsc_khz (void)
+{
+  if (tsc_khz == 0)
+    tsc_khz = tsc_calibrate ();
+
+  return tsc_khz;
+}
@@ -0,0 +1,599 @@
+/*
+ *    bench.c: In-kernel benchmarks
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <bench.h>
+#include <endpoint.h>
+#include <frame.h>
+#include <notification.h>
+#include <prof.h>
+#include <sched.h>
+#include <thread.h>
+
+/* Frames held at once by the frame allocator benchmark, per order */
+#define BENCH_FRAME_BATCH  256
+#define BENCH_FRAME_ROUNDS 64
+
+/* Scheduler benchmark: threads of each kind, run time, and iterations
+   of the CPU-bound loop between yields */
+#define BENCH_SCHED_CPU_THREADS 4
+#define BENCH_SCHED_IPC_PAIRS   4
+#define BENCH_SCHED_MS          2000
+#define BENCH_SCHED_WORK        10000
+
+/* IPC ping-pong: untimed and timed round trips */
+#define BENCH_IPC_WARMUP        1000
+#define BENCH_IPC_ROUNDS        100000
+
+/* Yields per thread in the FPU switch benchmark */
+#define BENCH_FPU_SWITCHES      100000
+
+/* First word of the message that makes an IPC server exit */
+#define BENCH_IPC_QUIT          ((uintptr_t) -1)
+
+struct bench
+{
+  const char *name;
+  void      (*func) (void);
+};
+
+/* Thread started by a benchmark. It signals bit BIT of bench_done
+   when it is done. */
+struct bench_worker
+{
+  unsigned int     bit;
+  unsigned int     mask;    /* Affinity */
+  struct endpoint *ep;      /* IPC threads */
+  unsigned long    count;   /* Units of work done */
+  uint64_t         cycles;  /* Timed part, if any */
+  int              fpu;     /* Touches the FPU between switches */
+};
+
+static uintptr_t bench_frames[BENCH_FRAME_BATCH];
+
+static struct notification *bench_done;
+
+/* Set to make the scheduler benchmark threads stop */
+static volatile int bench_stop;
+
+static volatile uint32_t bench_sink;
+
+static volatile double bench_fpu_sink = 1.0;
+
+/* FPU benchmark threads that made it to CPU 0 */
+static volatile unsigned int bench_fpu_started;
+
+/* Allocate a batch and free it, which splits and merges blocks, then
+   free every block right after allocating it, which is what most
+   callers do */
+static void
+bench_frame_order (unsigned int order)
+{
+  uint64_t alloc = 0, release = 0, pair = 0;
+  uint64_t t0;
+  unsigned int count, i, j;
+
+  if ((count = frame_count_free () >> (order + 1)) > BENCH_FRAME_BATCH)
+    count = BENCH_FRAME_BATCH;
+
+  if (count == 0)
+    return;
+
+  for (i = 0; i < BENCH_FRAME_ROUNDS; ++i)
+  {
+    t0 = __arch_cycles ();
+
+    for (j = 0; j < count; ++j)
+      bench_frames[j] = order == 0
+        ? frame_alloc ()
+        : frame_alloc_pages (order);
+
+    alloc += __arch_cycles () - t0;
+
+    t0 = __arch_cycles ();
+
+    for (j = 0; j < count; ++j)
+      if (order == 0)
+        frame_free (bench_frames[j]);
+      else
+        frame_free_pages (bench_frames[j], order);
+
+    release += __arch_cycles () - t0;
+
+    t0 = __arch_cycles ();
+
+    for (j = 0; j < count; ++j)
+      if (order == 0)
+        frame_free (frame_alloc ());
+      else
+        frame_free_pages (frame_alloc_pages (order), order);
+
+    pair += __arch_cycles () - t0;
+  }
+
+  count *= BENCH_FRAME_ROUNDS;
+
+  printf (
+    "  %5u %10u %10llu %10llu %10llu\n",
+    order,
+    count,
+    alloc / count,
+    release / count,
+    pair / count);
+}
+
+static void
+bench_frame (void)
+{
+  static const unsigned int orders[] = {0, 1, 4, 8};
+  unsigned int i;
+
+  printf ("Frame allocator (cycles per call, %u frames free):\n",
+          frame_count_free ());
+  printf ("  %5s %10s %10s %10s %10s\n",
+          "order", "calls", "alloc", "free", "alloc+free");
+
+  for (i = 0; i < sizeof (orders) / sizeof (orders[0]); ++i)
+    bench_frame_order (orders[i]);
+}
+
+static int
+bench_spawn (const char *name, void (*entry) (void *), struct bench_worker *worker)
+{
+  if (thread_create (name, entry, worker, SCHED_PRIORITY_DEFAULT) == NULL)
+  {
+    printf ("bench: cannot create thread %s\n", name);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Wait until every thread in BITS is done */
+static void
+bench_wait (uint32_t bits)
+{
+  uint32_t done = 0;
+
+  while ((done |= notification_wait (bench_done)) != bits)
+    ;
+}
+
+static void
+bench_worker_start (struct bench_worker *worker)
+{
+  if (worker->mask != THREAD_AFFINITY_ALL)
+    (void) sched_set_affinity (thread_self (), worker->mask);
+}
+
+static void
+bench_worker_done (struct bench_worker *worker)
+{
+  notification_signal (bench_done, 1u << worker->bit);
+}
+
+/* Echoes calls until it receives BENCH_IPC_QUIT */
+static void
+bench_ipc_server (void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *) arg;
+  uintptr_t msg[IPC_MSG_WORDS];
+
+  bench_worker_start (worker);
+
+  (void) endpoint_recv (worker->ep, msg);
+
+  while (msg[0] != BENCH_IPC_QUIT)
+  {
+    ++worker->count;
+
+    (void) endpoint_reply_recv (worker->ep, msg);
+  }
+
+  bench_worker_done (worker);
+}
+
+static void
+bench_ipc_quit (struct endpoint *ep)
+{
+  uintptr_t msg[IPC_MSG_WORDS] = {BENCH_IPC_QUIT};
+
+  (void) endpoint_send (ep, msg);
+}
+
+/* Kernel threads are not preemptible: CPU-bound ones yield after each
+   unit of work */
+static void
+bench_sched_cpu (void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *) arg;
+  uint32_t seed = worker->bit;
+  unsigned int i;
+
+  bench_worker_start (worker);
+
+  while (!bench_stop)
+  {
+    for (i = 0; i < BENCH_SCHED_WORK; ++i)
+      seed = seed * 1103515245 + 12345;
+
+    ++worker->count;
+
+    sched_yield ();
+  }
+
+  bench_sink += seed;
+
+  bench_worker_done (worker);
+}
+
+static void
+bench_sched_client (void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *) arg;
+  uintptr_t msg[IPC_MSG_WORDS] = {0};
+
+  bench_worker_start (worker);
+
+  while (!bench_stop)
+  {
+    (void) endpoint_call (worker->ep, msg);
+
+    ++worker->count;
+  }
+
+  bench_ipc_quit (worker->ep);
+
+  bench_worker_done (worker);
+}
+
+/* CPU-bound threads and IPC client/server pairs, free to run anywhere,
+   for a fixed time */
+static void
+bench_sched (void)
+{
+  struct bench_worker cpu[BENCH_SCHED_CPU_THREADS];
+  struct bench_worker client[BENCH_SCHED_IPC_PAIRS];
+  struct bench_worker server[BENCH_SCHED_IPC_PAIRS];
+  unsigned long cpu_total = 0, ipc_total = 0;
+  uint32_t bits = 0;
+  uint64_t deadline;
+  unsigned int i;
+
+  memset (cpu, 0, sizeof (cpu));
+  memset (client, 0, sizeof (client));
+  memset (server, 0, sizeof (server));
+
+  bench_stop = 0;
+
+  for (i = 0; i < BENCH_SCHED_CPU_THREADS; ++i)
+  {
+    cpu[i].bit  = i;
+    cpu[i].mask = THREAD_AFFINITY_ALL;
+
+    if (bench_spawn ("bench-cpu", bench_sched_cpu, &cpu[i]) == 0)
+      bits |= 1u << cpu[i].bit;
+  }
+
+  for (i = 0; i < BENCH_SCHED_IPC_PAIRS; ++i)
+  {
+    if ((client[i].ep = server[i].ep = endpoint_create ()) == NULL)
+    {
+      printf ("bench: cannot create endpoint\n");
+      break;
+    }
+
+    server[i].bit  = BENCH_SCHED_CPU_THREADS + 2 * i;
+    server[i].mask = THREAD_AFFINITY_ALL;
+    client[i].bit  = server[i].bit + 1;
+    client[i].mask = THREAD_AFFINITY_ALL;
+
+    if (bench_spawn ("bench-server", bench_ipc_server, &server[i]) == -1)
+      break;
+
+    bits |= 1u << server[i].bit;
+
+    if (bench_spawn ("bench-client", bench_sched_client, &client[i]) == -1)
+    {
+      bench_ipc_quit (server[i].ep);
+      break;
+    }
+
+    bits |= 1u << client[i].bit;
+  }
+
+  deadline = __arch_cycles () + (uint64_t) __arch_cycles_khz () * BENCH_SCHED_MS;
+
+  while (__arch_cycles () < deadline)
+    sched_yield ();
+
+  bench_stop = 1;
+
+  bench_wait (bits);
+
+  printf ("Scheduler (%u CPUs, %u ms, units per thread):\n",
+          __arch_cpu_count (),
+          BENCH_SCHED_MS);
+  printf ("  %-12s %10s %10s\n", "thread", "units", "per ms");
+
+  for (i = 0; i < BENCH_SCHED_CPU_THREADS; ++i)
+  {
+    printf ("  cpu %-8u %10lu %10lu\n",
+            i, cpu[i].count, cpu[i].count / BENCH_SCHED_MS);
+    cpu_total += cpu[i].count;
+  }
+
+  for (i = 0; i < BENCH_SCHED_IPC_PAIRS; ++i)
+  {
+    printf ("  ipc %-8u %10lu %10lu\n",
+            i, client[i].count, client[i].count / BENCH_SCHED_MS);
+    ipc_total += client[i].count;
+  }
+
+  printf ("  %-12s %10lu %10lu\n",
+          "cpu total", cpu_total, cpu_total / BENCH_SCHED_MS);
+  printf ("  %-12s %10lu %10lu\n",
+          "ipc total", ipc_total, ipc_total / BENCH_SCHED_MS);
+
+  sched_dump ();
+}
+
+/* Ping-pong client. The warm-up lets both threads settle on their
+   CPUs before timing. */
+static void
+bench_ipc_client (void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *) arg;
+  uintptr_t msg[IPC_MSG_WORDS] = {0};
+  unsigned int i;
+  uint64_t t0;
+
+  bench_worker_start (worker);
+
+  for (i = 0; i < BENCH_IPC_WARMUP; ++i)
+    (void) endpoint_call (worker->ep, msg);
+
+  t0 = __arch_cycles ();
+
+  for (i = 0; i < BENCH_IPC_ROUNDS; ++i)
+    (void) endpoint_call (worker->ep, msg);
+
+  worker->cycles = __arch_cycles () - t0;
+
+  bench_ipc_quit (worker->ep);
+
+  bench_worker_done (worker);
+}
+
+/* Cycles per round trip between a client on CPU CLIENT_CPU and a
+   server on SERVER_CPU, or 0 if the threads could not be created */
+static uint64_t
+bench_ipc_pair (unsigned int client_cpu, unsigned int server_cpu)
+{
+  struct bench_worker client, server;
+
+  memset (&client, 0, sizeof (struct bench_worker));
+  memset (&server, 0, sizeof (struct bench_worker));
+
+  if ((client.ep = server.ep = endpoint_create ()) == NULL)
+  {
+    printf ("bench: cannot create endpoint\n");
+    return 0;
+  }
+
+  server.bit  = 0;
+  server.mask = 1u << server_cpu;
+  client.bit  = 1;
+  client.mask = 1u << client_cpu;
+
+  if (bench_spawn ("bench-server", bench_ipc_server, &server) == -1)
+    return 0;
+
+  if (bench_spawn ("bench-client", bench_ipc_client, &client) == -1)
+  {
+    bench_ipc_quit (server.ep);
+    bench_wait (1u << server.bit);
+    return 0;
+  }
+
+  bench_wait ((1u << server.bit) | (1u << client.bit));
+
+  return client.cycles / BENCH_IPC_ROUNDS;
+}
+
+/* On the same CPU, calls and replies switch directly to the other
+   thread (sched_handoff). Across CPUs, each one is a remote wakeup. */
+static void
+bench_ipc (void)
+{
+  uint64_t local, remote = 0;
+
+  local = bench_ipc_pair (0, 0);
+
+  if (__arch_cpu_count () > 1)
+    remote = bench_ipc_pair (0, 1);
+
+  printf ("IPC call/reply ping-pong (cycles per round trip, %u rounds):\n",
+          BENCH_IPC_ROUNDS);
+  printf ("  %-12s %10llu\n", "same CPU", local);
+
+  if (__arch_cpu_count () > 1)
+    printf ("  %-12s %10llu\n", "across CPUs", remote);
+  else
+    printf ("  %-12s %10s\n", "across CPUs", "(1 CPU)");
+}
+
+/* Yield ping-pong on CPU 0, with an FPU instruction or two between
+   yields if asked to */
+static void
+bench_fpu_thread (void *arg)
+{
+  struct bench_worker *worker = (struct bench_worker *) arg;
+  unsigned int i;
+  uint64_t t0;
+
+  bench_worker_start (worker);
+
+  /* Kernel threads are not preemptible: no lock needed on one CPU */
+  ++bench_fpu_started;
+
+  while (bench_fpu_started < 2)
+    sched_yield ();
+
+  t0 = __arch_cycles ();
+
+  for (i = 0; i < BENCH_FPU_SWITCHES; ++i)
+  {
+    if (worker->fpu)
+      bench_fpu_sink *= 1.000001;
+
+    sched_yield ();
+  }
+
+  worker->cycles = __arch_cycles () - t0;
+
+  bench_worker_done (worker);
+}
+
+/* Cycles per switch. Each yield of the first thread is a switch to the
+   other one and a switch back. */
+static uint64_t
+bench_fpu_pair (int fpu0, int fpu1)
+{
+  struct bench_worker worker[2];
+  unsigned int i;
+
+  memset (worker, 0, sizeof (worker));
+
+  bench_fpu_started = 0;
+
+  for (i = 0; i < 2; ++i)
+  {
+    worker[i].bit  = i;
+    worker[i].mask = 1;
+    worker[i].fpu  = i == 0 ? fpu0 : fpu1;
+  }
+
+  if (bench_spawn ("bench-fpu", bench_fpu_thread, &worker[0]) == -1)
+    return 0;
+
+  if (bench_spawn ("bench-fpu", bench_fpu_thread, &worker[1]) == -1)
+  {
+    /* Let the first one go on alone */
+    ++bench_fpu_started;
+    bench_wait (1u << worker[0].bit);
+    return 0;
+  }
+
+  bench_wait ((1u << worker[0].bit) | (1u << worker[1].bit));
+
+  return worker[0].cycles / (2 * BENCH_FPU_SWITCHES);
+}
+
+static void
+bench_fpu (void)
+{
+  uint64_t none, one, both;
+
+  none = bench_fpu_pair (0, 0);
+  one  = bench_fpu_pair (1, 0);
+  both = bench_fpu_pair (1, 1);
+
+  printf ("Context switch (cycles per switch, 2 threads on CPU 0):\n");
+  printf ("  %-24s %10llu\n", "no FPU use", none);
+  printf ("  %-24s %10llu\n", "one thread uses the FPU", one);
+  printf ("  %-24s %10llu\n", "both use the FPU", both);
+  printf ("  FPU state: %u bytes per thread that uses it, none otherwise\n",
+          (unsigned int) __arch_fpu_state_size ());
+}
+
+static const struct bench bench_list[] =
+{
+  {"frame",   bench_frame},
+  {"int",     __arch_bench_int},
+  {"irq",     __arch_bench_irq},
+  {"syscall", __arch_bench_syscall},
+  {"tlb",     __arch_bench_tlb},
+  {"sched",   bench_sched},
+  {"ipc",     bench_ipc},
+  {"fpu",     bench_fpu}
+};
+
+/* Whether NAME is in the comma-separated list at OPTION */
+static int
+bench_selected (const char *option, const char *name)
+{
+  size_t len = strlen (name);
+
+  while (*option != '\0' && *option != ' ')
+  {
+    if (strncmp (option, name, len) == 0 &&
+        (option[len] == ',' || option[len] == ' ' || option[len] == '\0'))
+      return 1;
+
+    while (*option != '\0' && *option != ' ' && *option++ != ',')
+      ;
+  }
+
+  return 0;
+}
+
+static void
+bench_thread (void *option)
+{
+  unsigned int i;
+
+  /* Device interrupts are routed to the boot CPU (see bench=irq) */
+  (void) sched_set_affinity (thread_self (), 1);
+
+  for (i = 0; i < sizeof (bench_list) / sizeof (bench_list[0]); ++i)
+    if (bench_selected (option, bench_list[i].name))
+      (bench_list[i].func) ();
+
+  printf ("Benchmarks done\n");
+
+  prof_finish ();
+}
+
+int
+bench_start (void)
+{
+  const char *option;
+
+  if ((option = __arch_boot_option ("bench")) == NULL)
+    return -1;
+
+  if ((bench_done = notification_create ()) == NULL)
+  {
+    printf ("bench: cannot create notification\n");
+    return -1;
+  }
+
+  if (thread_create ("bench", bench_thread, (void *) option, SCHED_PRIORITY_DEFAULT) == NULL)
+  {
+    printf ("bench: cannot create benchmark thread\n");
+    return -1;
+  }
+
+  return 0;
+}
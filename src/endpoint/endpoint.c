@@ -0,0 +1,301 @@
+/*
+ *    endpoint.c: Synchronous IPC endpoints
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <endpoint.h>
+#include <sched.h>
+#include <slab.h>
+#include <thread.h>
+
+static struct slab_cache *endpoint_cache;
+
+static struct endpoint *endpoint_table[ENDPOINT_MAX];
+
+static spin_t endpoint_table_lock;
+
+static inline void
+ipc_queue_push (struct thread **head, struct thread **tail, struct thread *thread)
+{
+  thread->ipc_next = NULL;
+
+  if (*head == NULL)
+    *head = thread;
+  else
+    (*tail)->ipc_next = thread;
+
+  *tail = thread;
+}
+
+static inline struct thread *
+ipc_queue_pop (struct thread **head)
+{
+  struct thread *thread;
+
+  if ((thread = *head) != NULL)
+    *head = thread->ipc_next;
+
+  return thread;
+}
+
+static inline void
+ipc_copy (uintptr_t *dst, const uintptr_t *src)
+{
+  unsigned int i;
+
+  for (i = 0; i < IPC_MSG_WORDS; ++i)
+    dst[i] = src[i];
+}
+
+struct endpoint *
+endpoint_create (void)
+{
+  struct endpoint *ep;
+  unsigned int i;
+
+  if ((ep = slab_alloc (endpoint_cache)) == NULL)
+    return NULL;
+
+  memset (ep, 0, sizeof (struct endpoint));
+
+  spin_lock (&endpoint_table_lock);
+
+  for (i = 0; i < ENDPOINT_MAX; ++i)
+    if (endpoint_table[i] == NULL)
+    {
+      ep->id            = i;
+      endpoint_table[i] = ep;
+      break;
+    }
+
+  spin_unlock (&endpoint_table_lock);
+
+  if (i == ENDPOINT_MAX)
+  {
+    slab_free (endpoint_cache, ep);
+    return NULL;
+  }
+
+  return ep;
+}
+
+struct endpoint *
+endpoint_lookup (unsigned int id)
+{
+  if (id >= ENDPOINT_MAX)
+    return NULL;
+
+  return endpoint_table[id];
+}
+
+/* Hand MSG to the thread whose call SELF received last, if any, and
+   return it. A caller is blocked for sure once its ipc_lock is ours,
+   and we are the only one who may wake it. */
+static struct thread *
+endpoint_deliver_reply (struct thread *self, const uintptr_t *msg)
+{
+  struct thread *caller;
+
+  if ((caller = self->ipc_caller) == NULL)
+    return NULL;
+
+  self->ipc_caller = NULL;
+
+  spin_lock (&caller->ipc_lock);
+
+  ipc_copy (caller->ipc_msg, msg);
+
+  spin_unlock (&caller->ipc_lock);
+
+  return caller;
+}
+
+/* EP locked, interrupts disabled. Get the next message into MSG,
+   waiting for one if needed, and unlock EP. REPLY_TO, if not NULL, is
+   woken up as well: if we have to wait, we switch to it directly. */
+static void
+endpoint_wait_message (struct endpoint *ep,
+                       struct thread *self,
+                       struct thread *reply_to,
+                       uintptr_t *msg)
+{
+  struct thread *sender;
+
+  if ((sender = ipc_queue_pop (&ep->senders)) != NULL)
+  {
+    ipc_copy (msg, sender->ipc_msg);
+
+    /* A caller stays blocked until we reply */
+    if (sender->ipc_call)
+    {
+      self->ipc_caller = sender;
+      sender = NULL;
+    }
+
+    spin_unlock (&ep->lock);
+
+    if (sender != NULL)
+      sched_wakeup (sender);
+
+    if (reply_to != NULL)
+      sched_wakeup (reply_to);
+
+    return;
+  }
+
+  ipc_queue_push (&ep->receivers, &ep->receivers_tail, self);
+
+  if (reply_to != NULL)
+    sched_handoff (&ep->lock, reply_to);
+  else
+    sched_block (&ep->lock);
+
+  /* The sender also left ipc_caller set */
+  ipc_copy (msg, self->ipc_msg);
+}
+
+int
+endpoint_send (struct endpoint *ep, const uintptr_t *msg)
+{
+  struct thread *self = thread_self ();
+  struct thread *receiver;
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&ep->lock);
+
+  if ((receiver = ipc_queue_pop (&ep->receivers)) != NULL)
+  {
+    ipc_copy (receiver->ipc_msg, msg);
+
+    receiver->ipc_caller = NULL;
+
+    spin_unlock (&ep->lock);
+
+    sched_wakeup (receiver);
+  }
+  else
+  {
+    ipc_copy (self->ipc_msg, msg);
+
+    self->ipc_call = 0;
+
+    ipc_queue_push (&ep->senders, &ep->senders_tail, self);
+
+    sched_block (&ep->lock);
+  }
+
+  __arch_irq_restore (flags);
+
+  return 0;
+}
+
+int
+endpoint_recv (struct endpoint *ep, uintptr_t *msg)
+{
+  struct thread *self = thread_self ();
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&ep->lock);
+
+  self->ipc_caller = NULL;
+
+  endpoint_wait_message (ep, self, NULL, msg);
+
+  __arch_irq_restore (flags);
+
+  return 0;
+}
+
+int
+endpoint_call (struct endpoint *ep, uintptr_t *msg)
+{
+  struct thread *self = thread_self ();
+  struct thread *receiver;
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&ep->lock);
+
+  if ((receiver = ipc_queue_pop (&ep->receivers)) != NULL)
+  {
+    /* Fastpath: the receiver runs next, right here */
+    ipc_copy (receiver->ipc_msg, msg);
+
+    receiver->ipc_caller = self;
+
+    /* Keeps the reply out until we are blocked */
+    spin_lock (&self->ipc_lock);
+
+    spin_unlock (&ep->lock);
+
+    sched_handoff (&self->ipc_lock, receiver);
+  }
+  else
+  {
+    ipc_copy (self->ipc_msg, msg);
+
+    self->ipc_call = 1;
+
+    ipc_queue_push (&ep->senders, &ep->senders_tail, self);
+
+    sched_block (&ep->lock);
+  }
+
+  __arch_irq_restore (flags);
+
+  ipc_copy (msg, self->ipc_msg);
+
+  return 0;
+}
+
+int
+endpoint_reply_recv (struct endpoint *ep, uintptr_t *msg)
+{
+  struct thread *self = thread_self ();
+  struct thread *caller;
+  uintptr_t flags;
+
+  caller = endpoint_deliver_reply (self, msg);
+
+  flags = spin_lock_irqsave (&ep->lock);
+
+  endpoint_wait_message (ep, self, caller, msg);
+
+  __arch_irq_restore (flags);
+
+  return 0;
+}
+
+void
+endpoint_init (void)
+{
+  if ((endpoint_cache = slab_cache_create (
+         "endpoint",
+         sizeof (struct endpoint),
+         CACHE_LINE_SIZE,
+         0,
+         NULL)) == NULL)
+  {
+    printf ("endpoint: cannot create endpoint cache\n");
+    __arch_machine_halt ();
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ *    endpoint.h: Synchronous IPC endpoints
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ENDPOINT_H
+#define _ENDPOINT_H
+
+#include <atomik/atomik.h>
+#include <atomik/ipc.h>
+#include <spinlock.h>
+
+#include <thread.h>
+
+/* Endpoints are rendezvous points: nothing is buffered. A sender waits
+   for a receiver and the other way around, queued in FIFO order. A
+   call is a send followed by a wait for the reply, which the receiver
+   gives with endpoint_reply_recv. When the other side is already
+   waiting, call and reply_recv switch to it directly, bypassing the
+   run queues. */
+#define ENDPOINT_MAX 256
+
+struct endpoint
+{
+  spin_t         lock;
+  unsigned int   id;
+
+  /* Waiting threads, linked through ipc_next. At most one of these is
+     not empty. */
+  struct thread *senders;
+  struct thread *senders_tail;
+  struct thread *receivers;
+  struct thread *receivers_tail;
+};
+
+/* Returns NULL if out of memory or identifiers */
+struct endpoint *endpoint_create (void);
+
+/* Endpoint with identifier ID, or NULL */
+struct endpoint *endpoint_lookup (unsigned int);
+
+/* All of these take and return IPC_MSG_WORDS words in MSG, and return 0
+   (or -errno for the system calls built on them) */
+int endpoint_send (struct endpoint *, const uintptr_t *);
+int endpoint_recv (struct endpoint *, uintptr_t *);
+
+/* MSG is replaced by the reply */
+int endpoint_call (struct endpoint *, uintptr_t *);
+
+/* Reply with MSG to the thread whose call we received last, if any, and
+   wait for the next message on the endpoint */
+int endpoint_reply_recv (struct endpoint *, uintptr_t *);
+
+void endpoint_init (void);
+
+#endif /* _ENDPOINT_H */
@@ -24,9 +24,145 @@
 /* Send a character to the debug device (usually the serial port) */
 void __arch_debug_putchar (uint8_t);
 
+/* Same, for a whole span of bytes at once */
+void __arch_debug_write (const void *, size_t);
+
+/* Value of a NAME=VALUE boot option, up to the next space or the end
+   of the string. NULL if not given. */
+const char *__arch_boot_option (const char *);
+
+/* Time interrupt entry and exit, from the kernel and from userland,
+   and print the results (bench=int) */
+void __arch_bench_int (void);
+
+/* Time the delivery of a device interrupt, from pending to handler
+   and from handler back to the interrupted code (bench=irq). Must run
+   on CPU 0, where device interrupts are routed. */
+void __arch_bench_irq (void);
+
+/* Time a null system call from userland through every entry path the
+   CPU has (bench=syscall) */
+void __arch_bench_syscall (void);
+
+/* Time TLB refills after an address space switch, with and without
+   global kernel pages (bench=tlb) */
+void __arch_bench_tlb (void);
+
 /* Halt machine */
 void __arch_machine_halt (void);
 
+/* Free-running cycle counter */
+uint64_t __arch_cycles (void);
+
+/* Rate of __arch_cycles (), calibrated at boot */
+uint32_t __arch_cycles_khz (void);
+
+/* Close a boot phase: time since the previous mark is accounted to it */
+void __arch_boot_mark (const char *);
+
+/* Print how long each boot phase took */
+void __arch_boot_report (void);
+
+/* Sleep until the next interrupt, enabling interrupts. Call it with
+   interrupts disabled once it is known there is nothing to do: no
+   interrupt can be lost between the check and the sleep. */
+void __arch_idle (void);
+
+/* One-shot timer. HANDLER runs in interrupt context, on the CPU that
+   set the deadline, once __arch_cycles () reaches it. It may also run
+   before that, so it must check. */
+void __arch_timer_init (void (*) (void));
+
+/* Deadline in __arch_cycles () units for this CPU, or 0 to disarm */
+void __arch_timer_set_deadline (uint64_t);
+
+/* System call entry. HANDLER gets the call number and an array with the
+   four argument registers, and its return value is handed back to the
+   caller. Whatever it leaves in the array is loaded back into those
+   registers, so calls may return more than one value. */
+void __arch_syscall_init (uintptr_t (*) (uintptr_t, uintptr_t *));
+
+/* Lazy FPU switching. Every thread owns a pointer-sized slot, NULL
+   until it first uses the FPU, in which the arch layer keeps its FPU
+   state. __arch_fpu_switch makes SLOT the current one on this CPU; the
+   state is only saved and restored when actually needed. */
+void __arch_fpu_switch (void **);
+
+/* Write back the state in SLOT if the thread changed it on this CPU
+   since it was switched in, so that it may run on another. Called
+   whenever a thread is switched out; free if it did not use the FPU. */
+void __arch_fpu_flush (void **);
+
+/* Forget SLOT (thread exit) and free its state */
+void __arch_fpu_free (void **);
+
+/* Size of the state allocated for a thread that uses the FPU */
+size_t __arch_fpu_state_size (void);
+
+/* From interrupt context: store the interrupted program counter in
+   PCS[0], followed by up to MAX - 1 return addresses of the interrupted
+   kernel code. Returns how many were stored, 0 if not in an interrupt. */
+unsigned int __arch_irq_backtrace (uintptr_t *, unsigned int);
+
+/* Kernel thread contexts are just saved stack pointers: everything
+   else is pushed on the thread's own stack. __arch_context_init prepares
+   STACK so that switching to it calls ENTRY (ARG), which must never
+   return, and gives the stack pointer to switch to. */
+uintptr_t __arch_context_init (void *, size_t, void (*) (void *), void *);
+
+/* Save the current context in *FROM and resume TO. Interrupts must be
+   disabled. */
+void __arch_context_switch (uintptr_t *, uintptr_t);
+
+/* Stack to use when userland enters the kernel on this CPU */
+void __arch_set_kernel_stack (uintptr_t);
+
+/* Preemption point. HANDLER runs with interrupts disabled when the
+   outermost interrupt handler is done and the interrupt acknowledged.
+   Its argument tells whether userland was interrupted. It may switch
+   contexts. */
+void __arch_preempt_init (void (*) (int));
+
+/* Index of the CPU we are running on, from 0 to CPU_MAX - 1 */
+unsigned int __arch_cpu_id (void);
+
+/* Number of CPUs online. Their indexes go from 0 to this minus one. */
+unsigned int __arch_cpu_count (void);
+
+/* Bring up the other CPUs, one at a time. Each of them runs ENTRY, on
+   a stack of its own and with interrupts disabled, once the arch layer
+   is done with it; ENTRY must not return. Call it once the timer is set
+   up. Returns the number of CPUs online. */
+unsigned int __arch_smp_start (void (*) (void));
+
+/* Interrupt CPU, so that it goes through its preemption point soon */
+void __arch_cpu_kick (unsigned int);
+
+/* Disable interrupts, returning the previous state */
+uintptr_t __arch_irq_save (void);
+
+/* Restore the interrupt state returned by __arch_irq_save */
+void __arch_irq_restore (uintptr_t);
+
+/* Enable interrupts unconditionally */
+void __arch_irq_enable (void);
+
+/* Run HANDLER, with interrupts disabled, every time hardware interrupt
+   line IRQ fires. Returns -1 if the line does not exist or is taken. */
+int __arch_irq_attach (unsigned int, void (*) (unsigned int, void *), void *);
+
+/* Stop and resume delivery of an attached IRQ line. A handler that
+   cannot quiet the device itself (it is driven from userland) masks
+   the line until the device has been serviced. Fine from any CPU,
+   interrupt handlers included. */
+void __arch_irq_mask (unsigned int);
+void __arch_irq_unmask (unsigned int);
+
+/* Call FUNC for every range [start, end) of physical memory that is
+   available for allocation (i.e. not used by the kernel image, boot
+   modules or boot-time page tables) */
+void __arch_enum_free_memory (void (*) (uintptr_t, uintptr_t, void *), void *);
+
  /* Initialize hardware (generic way) */
 void machine_init (void);
 
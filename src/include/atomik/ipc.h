@@ -0,0 +1,28 @@
+/*
+ *    ipc.h: IPC message format
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ATOMIK_IPC_H
+#define _ATOMIK_IPC_H
+
+/* Messages are short and travel in registers only: the first argument
+   of the IPC system calls names the endpoint, and the remaining three
+   carry the message words, both ways. Anything bigger must go through
+   shared memory. */
+#define IPC_MSG_WORDS 3
+
+#endif /* _ATOMIK_IPC_H */
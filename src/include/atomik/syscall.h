@@ -0,0 +1,46 @@
+/*
+ *    syscall.h: System call numbers
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ATOMIK_SYSCALL_H
+#define _ATOMIK_SYSCALL_H
+
+/* Does nothing. Measures the cost of entering and leaving the kernel. */
+#define SYS_NULL            0
+
+/* Synchronous IPC (see atomik/ipc.h). Arguments are the endpoint and
+   the three message words, which RECV, CALL and REPLY_RECV overwrite
+   with the message received. All return 0 or -errno. */
+#define SYS_ENDPOINT_CREATE 1 /* Returns the new endpoint */
+#define SYS_SEND            2 /* Block until received */
+#define SYS_RECV            3 /* Block until a message arrives */
+#define SYS_CALL            4 /* Send, then block until the reply */
+#define SYS_REPLY_RECV      5 /* Reply to the last caller, then receive */
+
+/* Asynchronous notifications. WAIT and POLL leave the bits taken in
+   the second argument. All but NOTIFICATION_CREATE return 0 or
+   -errno. */
+#define SYS_NOTIFICATION_CREATE 6  /* Returns the new notification */
+#define SYS_SIGNAL              7  /* Notification, bits */
+#define SYS_WAIT                8  /* Notification */
+#define SYS_POLL                9  /* Notification */
+#define SYS_IRQ_BIND            10 /* Notification, IRQ, bits */
+#define SYS_IRQ_ACK             11 /* IRQ */
+
+#define SYS_COUNT               12
+
+#endif /* _ATOMIK_SYSCALL_H */
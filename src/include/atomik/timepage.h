@@ -0,0 +1,78 @@
+/*
+ *    timepage.h: Time page shared with userland
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _ATOMIK_TIMEPAGE_H
+#define _ATOMIK_TIMEPAGE_H
+
+#include <stdint.h>
+
+#define ATOMIK_TIME_PAGE_VERSION 1
+
+/* Mapped read-only in tasks that want it. Times are obtained from the
+   cycle counter (RDTSC on x86) without entering the kernel:
+
+     ns = ns_base + ((cycles - cycle_base) * mult) >> shift
+
+   The kernel bumps seq before and after every update, so a reader that
+   saw an odd value, or a different value at the end, must retry. */
+struct atomik_time_page
+{
+  volatile uint32_t seq;
+  uint32_t          version;
+  uint32_t          mult;
+  uint32_t          shift;
+  uint64_t          cycle_base;
+  uint64_t          ns_base;          /* CLOCK_MONOTONIC at cycle_base */
+  int64_t           realtime_offset;  /* CLOCK_REALTIME - CLOCK_MONOTONIC */
+};
+
+/* (CYCLES * MULT) >> SHIFT without a 96-bit product: two 32x32
+   multiplies and no division. SHIFT must be in [1, 32]. */
+static inline uint64_t
+atomik_cycles_to_ns (uint64_t cycles, uint32_t mult, uint32_t shift)
+{
+  return (((cycles >> 32) * mult) << (32 - shift))
+    + (((cycles & 0xffffffff) * mult) >> shift);
+}
+
+static inline uint64_t
+atomik_time_page_monotonic (const struct atomik_time_page *page,
+                            uint64_t (*read_cycles) (void))
+{
+  uint32_t seq;
+  uint64_t ns;
+
+  do
+  {
+    while ((seq = page->seq) & 1);
+
+    __asm__ __volatile__ ("" ::: "memory");
+
+    ns = page->ns_base + atomik_cycles_to_ns (
+      read_cycles () - page->cycle_base,
+      page->mult,
+      page->shift);
+
+    __asm__ __volatile__ ("" ::: "memory");
+  }
+  while (page->seq != seq);
+
+  return ns;
+}
+
+#endif /* _ATOMIK_TIMEPAGE_H */
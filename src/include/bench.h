@@ -0,0 +1,28 @@
+/*
+ *    bench.h: In-kernel benchmarks
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/* Benchmarks are selected with bench=NAME[,NAME...] in the kernel
+   command line. Once the system is up, they run one after the other in
+   a thread of their own and print their results. Returns -1 if there
+   is nothing to run. */
+int bench_start (void);
+
+#endif /* _BENCH_H */
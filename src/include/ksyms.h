@@ -0,0 +1,49 @@
+/*
+ *    ksyms.h: Embedded kernel symbol table
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _KSYMS_H
+#define _KSYMS_H
+
+#include <atomik/atomik.h>
+
+/* The debugsyms section holds a struct ksym_table followed by COUNT
+   entries sorted by address, followed by the NUL-terminated names the
+   entries point into. It is generated by tools/ksyms.sh on a first
+   link of the kernel and added on a second one; being the last section
+   of the image, it moves nothing else around. */
+#define KSYM_MAGIC 0x4d59534b /* "KSYM" */
+
+struct ksym
+{
+  uint32_t addr;
+  uint32_t name;  /* Offset in the string pool */
+};
+
+struct ksym_table
+{
+  uint32_t    magic;
+  uint32_t    count;
+  struct ksym syms[];
+};
+
+/* Name of the function containing ADDR, NULL if unknown. If OFFSET is
+   not NULL, it receives the distance from the start of the function.
+   O(log n). */
+const char *ksym_lookup (uintptr_t, uintptr_t *);
+
+#endif /* _KSYMS_H */
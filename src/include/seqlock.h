@@ -0,0 +1,65 @@
+/*
+ *    seqlock.h: Sequence counters for read-mostly data
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+#include <alltypes.h>
+#include <atomic.h>
+
+/* Readers never block writers: they retry if the counter was odd (an
+   update in progress) or changed while they were reading. Writers must
+   be serialized by other means. */
+typedef volatile uint32_t seq_t;
+
+static inline void
+seq_write_begin (seq_t *seq)
+{
+  ++*seq;
+  a_barrier ();
+}
+
+static inline void
+seq_write_end (seq_t *seq)
+{
+  a_barrier ();
+  ++*seq;
+}
+
+static inline uint32_t
+seq_read_begin (const seq_t *seq)
+{
+  uint32_t start;
+
+  while ((start = *seq) & 1)
+    a_spin ();
+
+  a_barrier ();
+
+  return start;
+}
+
+static inline int
+seq_read_retry (const seq_t *seq, uint32_t start)
+{
+  a_barrier ();
+
+  return *seq != start;
+}
+
+#endif /* _SEQLOCK_H */
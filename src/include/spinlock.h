@@ -0,0 +1,70 @@
+/*
+ *    spinlock.h: Busy-waiting locks
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include <alltypes.h>
+#include <atomic.h>
+#include <arch.h>
+
+typedef volatile int spin_t;
+
+#define SPIN_UNLOCKED 0
+
+static inline void
+spin_lock (spin_t *lock)
+{
+  while (a_swap (lock, 1))
+    while (*lock)
+      a_spin ();
+}
+
+static inline int
+spin_trylock (spin_t *lock)
+{
+  return !a_swap (lock, 1);
+}
+
+static inline void
+spin_unlock (spin_t *lock)
+{
+  a_barrier ();
+  *lock = SPIN_UNLOCKED;
+}
+
+/* Variants for locks that may be taken from interrupt context */
+static inline uintptr_t
+spin_lock_irqsave (spin_t *lock)
+{
+  uintptr_t flags = __arch_irq_save ();
+
+  spin_lock (lock);
+
+  return flags;
+}
+
+static inline void
+spin_unlock_irqrestore (spin_t *lock, uintptr_t flags)
+{
+  spin_unlock (lock);
+
+  __arch_irq_restore (flags);
+}
+
+#endif /* _SPINLOCK_H */
@@ -0,0 +1,35 @@
+/*
+ *    syscall.h: System call dispatch
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _SYSCALL_H
+#define _SYSCALL_H
+
+#include <atomik/atomik.h>
+#include <atomik/syscall.h>
+
+#define SYSCALL_ARGS 4
+
+/* Arguments may be overwritten to return more values */
+typedef uintptr_t (*syscall_t) (uintptr_t *);
+
+/* Called from the arch entry paths. Errors are returned as -errno. */
+uintptr_t syscall_dispatch (uintptr_t, uintptr_t *);
+
+void syscall_init (void);
+
+#endif /* _SYSCALL_H */
@@ -0,0 +1,69 @@
+/*
+ *    klog.h: Per-CPU kernel log
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include <atomik/atomik.h>
+#include <stdarg.h>
+
+#define KLOG_EMERG   0
+#define KLOG_ALERT   1
+#define KLOG_CRIT    2
+#define KLOG_ERR     3
+#define KLOG_WARNING 4
+#define KLOG_NOTICE  5
+#define KLOG_INFO    6
+#define KLOG_DEBUG   7
+
+/* A record fills exactly two cache lines */
+#define KLOG_RECORD_SIZE (2 * CACHE_LINE_SIZE)
+#define KLOG_TEXT_MAX    (KLOG_RECORD_SIZE - 12)
+
+/* Records per CPU. Must be a power of two. */
+#define KLOG_RING_SIZE   64
+
+struct klog_record
+{
+  uint64_t timestamp; /* __arch_cycles () when the record was written */
+  uint16_t cpu;
+  uint8_t  level;
+  uint8_t  len;       /* Length of text, without the terminating NUL */
+  char     text[KLOG_TEXT_MAX];
+};
+
+/* Receives drained records, oldest first across all CPUs */
+typedef void (*klog_sink_t) (const struct klog_record *);
+
+/* Format a message into this CPU's ring. Never blocks: if the ring is
+   full the record is dropped and counted. Text longer than
+   KLOG_TEXT_MAX - 1 is truncated. */
+void klog (int, const char *, ...);
+void vklog (int, const char *, va_list);
+
+/* Hand every pending record to the sink. Meant for idle and halt
+   paths. If another CPU is already draining, returns immediately. */
+void klog_drain (void);
+
+/* Replace the sink. The default one writes to the debug device. */
+void klog_set_sink (klog_sink_t);
+
+/* Total number of records dropped so far because of full rings */
+unsigned long klog_dropped (void);
+
+#endif /* _KLOG_H */
@@ -0,0 +1,232 @@
+/*
+ *    klog.c: Per-CPU kernel log
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <klog.h>
+
+/* Single producer (the owning CPU, with interrupts disabled) and single
+   consumer (whoever holds klog_drain_lock), so no lock is needed to
+   append. head and tail live in different cache lines so that logging
+   does not bounce the line the drainer writes to. */
+struct klog_ring
+{
+  volatile unsigned int  head;
+  volatile unsigned long dropped;
+  volatile unsigned int  tail __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+  struct klog_record records[KLOG_RING_SIZE]
+    __attribute__ ((aligned (CACHE_LINE_SIZE)));
+};
+
+static struct klog_ring klog_rings[CPU_MAX];
+
+static spin_t klog_drain_lock = SPIN_UNLOCKED;
+
+static unsigned long klog_reported_dropped;
+
+static void klog_default_sink (const struct klog_record *);
+
+static klog_sink_t klog_sink = klog_default_sink;
+
+static void
+klog_default_sink (const struct klog_record *record)
+{
+  char prefix[32];
+  int len;
+
+  len = snprintf (
+    prefix,
+    sizeof (prefix),
+    "[%12llu] %u:%u ",
+    (unsigned long long) record->timestamp,
+    record->cpu,
+    record->level);
+
+  __arch_debug_write (prefix, len);
+  __arch_debug_write (record->text, record->len);
+  __arch_debug_write ("\n", 1);
+}
+
+static void
+klog_record_vfill (struct klog_record *record,
+                   int level,
+                   const char *fmt,
+                   va_list ap)
+{
+  int len;
+
+  record->timestamp = __arch_cycles ();
+  record->cpu       = __arch_cpu_id ();
+  record->level     = level;
+
+  len = vsnprintf (record->text, KLOG_TEXT_MAX, fmt, ap);
+
+  if (len < 0)
+    len = 0;
+  else if (len >= KLOG_TEXT_MAX)
+    len = KLOG_TEXT_MAX - 1;
+
+  /* Records are lines already */
+  if (len > 0 && record->text[len - 1] == '\n')
+    record->text[--len] = '\0';
+
+  record->len = len;
+}
+
+static void
+klog_record_fill (struct klog_record *record, int level, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start (ap, fmt);
+
+  klog_record_vfill (record, level, fmt, ap);
+
+  va_end (ap);
+}
+
+void
+vklog (int level, const char *fmt, va_list ap)
+{
+  struct klog_ring *ring;
+  unsigned int head;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  ring = &klog_rings[__arch_cpu_id ()];
+  head = ring->head;
+
+  if (head - ring->tail == KLOG_RING_SIZE)
+    ++ring->dropped;
+  else
+  {
+    klog_record_vfill (
+      &ring->records[head & (KLOG_RING_SIZE - 1)],
+      level,
+      fmt,
+      ap);
+
+    /* Publish the record only once it is complete */
+    a_barrier ();
+
+    ring->head = head + 1;
+  }
+
+  __arch_irq_restore (flags);
+}
+
+void
+klog (int level, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start (ap, fmt);
+
+  vklog (level, fmt, ap);
+
+  va_end (ap);
+}
+
+unsigned long
+klog_dropped (void)
+{
+  unsigned long dropped = 0;
+  unsigned int i;
+
+  for (i = 0; i < CPU_MAX; ++i)
+    dropped += klog_rings[i].dropped;
+
+  return dropped;
+}
+
+/* Oldest pending record of all rings. This assumes timestamps are
+   comparable across CPUs, i.e. synchronized TSCs. */
+static struct klog_ring *
+klog_oldest_ring (void)
+{
+  struct klog_ring *oldest = NULL;
+  struct klog_ring *ring;
+  unsigned int i;
+
+  for (i = 0; i < CPU_MAX; ++i)
+  {
+    ring = &klog_rings[i];
+
+    if (ring->tail == ring->head)
+      continue;
+
+    if (oldest == NULL
+        || ring->records[ring->tail & (KLOG_RING_SIZE - 1)].timestamp <
+           oldest->records[oldest->tail & (KLOG_RING_SIZE - 1)].timestamp)
+      oldest = ring;
+  }
+
+  return oldest;
+}
+
+void
+klog_drain (void)
+{
+  struct klog_record record;
+  struct klog_ring *ring;
+  unsigned long dropped;
+
+  if (!spin_trylock (&klog_drain_lock))
+    return;
+
+  while ((ring = klog_oldest_ring ()) != NULL)
+  {
+    /* Do not read the record before seeing the head that published it */
+    a_barrier ();
+
+    klog_sink (&ring->records[ring->tail & (KLOG_RING_SIZE - 1)]);
+
+    /* Nor free the slot before we are done with it */
+    a_barrier ();
+
+    ++ring->tail;
+  }
+
+  if ((dropped = klog_dropped ()) != klog_reported_dropped)
+  {
+    klog_record_fill (
+      &record,
+      KLOG_WARNING,
+      "klog: %lu records dropped",
+      dropped - klog_reported_dropped);
+
+    klog_sink (&record);
+
+    klog_reported_dropped = dropped;
+  }
+
+  spin_unlock (&klog_drain_lock);
+}
+
+void
+klog_set_sink (klog_sink_t sink)
+{
+  klog_sink = sink;
+}
@@ -0,0 +1,62 @@
+/*
+ *    ksyms.c: Embedded kernel symbol table
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stddef.h>
+
+#include <ksyms.h>
+
+extern char __start_debugsyms[];
+extern char __stop_debugsyms[];
+
+const char *
+ksym_lookup (uintptr_t addr, uintptr_t *offset)
+{
+  const struct ksym_table *table = (const struct ksym_table *) __start_debugsyms;
+  const char *strings;
+  unsigned int low, high, mid;
+
+  /* First-pass links carry no table */
+  if (__stop_debugsyms - __start_debugsyms < sizeof (struct ksym_table) ||
+      table->magic != KSYM_MAGIC ||
+      table->count == 0 ||
+      addr < table->syms[0].addr)
+    return NULL;
+
+  strings = (const char *) &table->syms[table->count];
+
+  /* Last entry not above ADDR */
+  low  = 0;
+  high = table->count;
+
+  while (high - low > 1)
+  {
+    mid = (low + high) / 2;
+
+    if (table->syms[mid].addr <= addr)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  if (offset != NULL)
+    *offset = addr - table->syms[low].addr;
+
+  return strings + table->syms[low].name;
+}
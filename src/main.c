@@ -21,12 +21,77 @@
 #include <stdio.h>
 #include <arch.h>
 
+#include <bench.h>
+#include <clock.h>
+#include <endpoint.h>
+#include <notification.h>
+#include <frame.h>
+#include <heap.h>
+#include <klog.h>
+#include <prof.h>
+#include <sched.h>
+#include <slab.h>
+#include <syscall.h>
+#include <timer.h>
+
+/* Where the other CPUs end up once the arch layer is done with them */
+static void
+ap_main (void)
+{
+  sched_init_cpu ();
+
+  prof_init_cpu ();
+
+  sched_idle ();
+}
+
 void
 main (void)
 {
   machine_init ();
 
-  printf ("Hello world (main loaded at %p)!\n", main);
-  
-  __arch_machine_halt ();
+  frame_init ();
+
+  __arch_boot_mark ("frame_init");
+
+  slab_init ();
+
+  heap_init ();
+
+  __arch_boot_mark ("slab_heap_init");
+
+  clock_init ();
+
+  timer_init ();
+
+  prof_init_cpu ();
+
+  __arch_boot_mark ("timer_init");
+
+  syscall_init ();
+
+  sched_init ();
+
+  endpoint_init ();
+  notification_init ();
+
+  __arch_boot_mark ("sched_init");
+
+  (void) __arch_smp_start (ap_main);
+
+  __arch_boot_mark ("smp_start");
+
+  klog (KLOG_INFO, "Hello world (main loaded at %p)!", main);
+
+  klog_drain ();
+
+  __arch_boot_report ();
+
+  /* The profile covers the benchmarks if there are any, or just the
+     boot otherwise */
+  if (bench_start () == -1)
+    prof_finish ();
+
+  /* Nothing else to do: main becomes this CPU's idle thread */
+  sched_idle ();
 }
@@ -0,0 +1,280 @@
+/*
+ *    buddy.c: Buddy allocator for physical frames
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <frame.h>
+
+/* Per-frame state: only the first frame of a free block is tagged */
+#define FRAME_STATE_FREE  0x80
+#define FRAME_STATE_ORDER 0x7f
+
+#define FRAME_MAX_RANGES  32
+
+/* Free blocks are linked through their own first frame */
+struct frame_block
+{
+  struct frame_block *next;
+  struct frame_block *prev;
+};
+
+struct frame_range
+{
+  uintptr_t start;
+  uintptr_t end;
+};
+
+static struct frame_block *free_lists[FRAME_MAX_ORDER + 1];
+static uint32_t            free_orders;  /* Bit N set if free_lists[N] is not empty */
+static size_t              free_frames;
+
+static uint8_t            *frame_state;  /* One byte per frame from frame_base on */
+static uintptr_t           frame_base;   /* First frame number being tracked */
+static uintptr_t           frame_limit;  /* Last frame number being tracked, plus one */
+
+static spin_t              frame_lock = SPIN_UNLOCKED;
+
+/* Free memory as reported by the arch layer, used during initialization */
+static struct frame_range  ranges[FRAME_MAX_RANGES];
+static unsigned int        range_count;
+
+static inline struct frame_block *
+frame_block_of (uintptr_t pfn)
+{
+  return (struct frame_block *) PHYS_TO_VIRT (pfn << PAGE_BITS);
+}
+
+static void
+frame_list_push (uintptr_t pfn, unsigned int order)
+{
+  struct frame_block *block = frame_block_of (pfn);
+
+  block->prev = NULL;
+  block->next = free_lists[order];
+
+  if (block->next != NULL)
+    block->next->prev = block;
+
+  free_lists[order] = block;
+  free_orders |= 1 << order;
+
+  frame_state[pfn - frame_base] = FRAME_STATE_FREE | order;
+}
+
+static void
+frame_list_remove (uintptr_t pfn, unsigned int order)
+{
+  struct frame_block *block = frame_block_of (pfn);
+
+  if (block->prev != NULL)
+    block->prev->next = block->next;
+  else
+    free_lists[order] = block->next;
+
+  if (block->next != NULL)
+    block->next->prev = block->prev;
+
+  if (free_lists[order] == NULL)
+    free_orders &= ~(1 << order);
+
+  frame_state[pfn - frame_base] = 0;
+}
+
+/* Put a block back in the free lists, merging it with its buddies */
+static void
+frame_release (uintptr_t pfn, unsigned int order)
+{
+  uintptr_t buddy;
+
+  while (order < FRAME_MAX_ORDER)
+  {
+    buddy = pfn ^ (1 << order);
+
+    if (buddy < frame_base || buddy >= frame_limit)
+      break;
+
+    if (frame_state[buddy - frame_base] != (FRAME_STATE_FREE | order))
+      break;
+
+    frame_list_remove (buddy, order);
+
+    pfn &= ~(uintptr_t) (1 << order);
+    ++order;
+  }
+
+  frame_list_push (pfn, order);
+}
+
+uintptr_t
+frame_alloc_pages (unsigned int order)
+{
+  uintptr_t flags;
+  uintptr_t pfn;
+  uint32_t candidates;
+  unsigned int current;
+
+  if (order > FRAME_MAX_ORDER)
+    return FRAME_INVALID;
+
+  flags = spin_lock_irqsave (&frame_lock);
+
+  /* Smallest non-empty list able to satisfy the request */
+  candidates = free_orders & ~((1 << order) - 1);
+
+  if (!candidates)
+  {
+    spin_unlock_irqrestore (&frame_lock, flags);
+
+    return FRAME_INVALID;
+  }
+
+  current = a_ctz_l (candidates);
+
+  pfn = VIRT_TO_PHYS (free_lists[current]) >> PAGE_BITS;
+
+  frame_list_remove (pfn, current);
+
+  /* Split it, giving back the upper halves */
+  while (current > order)
+  {
+    --current;
+    frame_list_push (pfn + (1 << current), current);
+  }
+
+  free_frames -= 1 << order;
+
+  spin_unlock_irqrestore (&frame_lock, flags);
+
+  return pfn << PAGE_BITS;
+}
+
+void
+frame_free_pages (uintptr_t addr, unsigned int order)
+{
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&frame_lock);
+
+  frame_release (addr >> PAGE_BITS, order);
+
+  free_frames += 1 << order;
+
+  spin_unlock_irqrestore (&frame_lock, flags);
+}
+
+size_t
+frame_count_free (void)
+{
+  return free_frames;
+}
+
+static void
+frame_add_range (uintptr_t start, uintptr_t end, void *data)
+{
+  if (range_count == FRAME_MAX_RANGES)
+  {
+    printf ("mm: too many memory ranges, ignoring %p-%p\n", (void *) start, (void *) end);
+    return;
+  }
+
+  ranges[range_count].start = start;
+  ranges[range_count].end   = end;
+
+  ++range_count;
+}
+
+/* Add [pfn, end) to the free lists as maximal, naturally aligned blocks */
+static void
+frame_seed (uintptr_t pfn, uintptr_t end)
+{
+  unsigned int order;
+
+  while (pfn < end)
+  {
+    order = FRAME_MAX_ORDER;
+
+    while (order > 0 && ((pfn & ((1 << order) - 1)) || pfn + (1 << order) > end))
+      --order;
+
+    frame_release (pfn, order);
+
+    free_frames += 1 << order;
+    pfn += 1 << order;
+  }
+}
+
+void
+frame_init (void)
+{
+  unsigned int i;
+  uintptr_t lo, hi;
+  size_t state_size;
+
+  __arch_enum_free_memory (frame_add_range, NULL);
+
+  if (range_count == 0)
+  {
+    printf ("mm: no free memory reported!\n");
+    __arch_machine_halt ();
+  }
+
+  lo = ranges[0].start >> PAGE_BITS;
+  hi = ranges[0].end >> PAGE_BITS;
+
+  for (i = 1; i < range_count; ++i)
+  {
+    if (ranges[i].start >> PAGE_BITS < lo)
+      lo = ranges[i].start >> PAGE_BITS;
+
+    if (ranges[i].end >> PAGE_BITS > hi)
+      hi = ranges[i].end >> PAGE_BITS;
+  }
+
+  /* Keep the base aligned so that the buddy of a tracked block is tracked */
+  frame_base  = lo & ~(uintptr_t) ((1 << FRAME_MAX_ORDER) - 1);
+  frame_limit = hi;
+
+  state_size = __ALIGN (frame_limit - frame_base, PAGE_SIZE);
+
+  /* The state array is taken from the first range big enough to hold it */
+  for (i = 0; i < range_count; ++i)
+    if (ranges[i].end - ranges[i].start >= state_size)
+    {
+      frame_state = PHYS_TO_VIRT (ranges[i].start);
+      ranges[i].start += state_size;
+      break;
+    }
+
+  if (frame_state == NULL)
+  {
+    printf ("mm: cannot allocate %zu bytes for frame bookkeeping\n", state_size);
+    __arch_machine_halt ();
+  }
+
+  memset (frame_state, 0, state_size);
+
+  for (i = 0; i < range_count; ++i)
+    frame_seed (ranges[i].start >> PAGE_BITS, ranges[i].end >> PAGE_BITS);
+
+  printf ("mm: %zu free frames (%zu KiB)\n", free_frames, free_frames << (PAGE_BITS - 10));
+}
@@ -0,0 +1,54 @@
+/*
+ *    frame.h: Physical frame allocator
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _MM_FRAME_H
+#define _MM_FRAME_H
+
+#include <alltypes.h>
+
+/* Largest contiguous run is 2^FRAME_MAX_ORDER frames (4 MiB with 4 KiB pages) */
+#define FRAME_MAX_ORDER 10
+
+/* Returned by the allocation functions when no memory is left */
+#define FRAME_INVALID   0
+
+/* Seed the allocator with the free memory reported by the arch layer */
+void frame_init (void);
+
+/* Allocate 2^order physically contiguous, naturally aligned frames */
+uintptr_t frame_alloc_pages (unsigned int order);
+
+/* Give back a run obtained with frame_alloc_pages (same order) */
+void frame_free_pages (uintptr_t, unsigned int order);
+
+/* Number of free frames */
+size_t frame_count_free (void);
+
+static inline uintptr_t
+frame_alloc (void)
+{
+  return frame_alloc_pages (0);
+}
+
+static inline void
+frame_free (uintptr_t addr)
+{
+  frame_free_pages (addr, 0);
+}
+
+#endif /* _MM_FRAME_H */
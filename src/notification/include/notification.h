@@ -0,0 +1,72 @@
+/*
+ *    notification.h: Asynchronous notifications
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _NOTIFICATION_H
+#define _NOTIFICATION_H
+
+#include <atomik/atomik.h>
+#include <spinlock.h>
+
+#include <thread.h>
+
+/* A notification is a word of pending bits. Signalling ORs bits into
+   it without taking any lock and never blocks, so it is fine from
+   interrupt context. Waiting takes the whole word and clears it. Only
+   a signal that makes the word non-zero can find a thread waiting, and
+   only then is the lock taken: further signals just accumulate. */
+#define NOTIFICATION_MAX     256
+
+/* IRQ lines that may be bound to notifications */
+#define NOTIFICATION_IRQ_MAX 64
+
+struct notification
+{
+  volatile int   word;
+  unsigned int   id;
+
+  spin_t         lock;     /* Protects the wait queue only */
+  struct thread *waiters;  /* Linked through ipc_next, FIFO */
+  struct thread *waiters_tail;
+};
+
+/* Returns NULL if out of memory or identifiers */
+struct notification *notification_create (void);
+
+/* Notification with identifier ID, or NULL */
+struct notification *notification_lookup (unsigned int);
+
+void     notification_signal (struct notification *, uint32_t);
+
+/* Take the pending bits, waiting for some if there are none */
+uint32_t notification_wait (struct notification *);
+
+/* Take the pending bits, possibly none, without blocking */
+uint32_t notification_poll (struct notification *);
+
+/* From now on, IRQ signals BITS on the notification. The line is then
+   masked until notification_irq_ack, so that the driver, woken up by
+   the notification, can service the device first. Returns -1 if the
+   line does not exist or is taken. */
+int  notification_bind_irq (struct notification *, unsigned int, uint32_t);
+
+/* Unmask a bound IRQ line. Returns -1 if not bound. */
+int  notification_irq_ack (unsigned int);
+
+void notification_init (void);
+
+#endif /* _NOTIFICATION_H */
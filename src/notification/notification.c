@@ -0,0 +1,232 @@
+/*
+ *    notification.c: Asynchronous notifications
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <atomic.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <notification.h>
+#include <sched.h>
+#include <slab.h>
+#include <thread.h>
+
+struct notification_irq
+{
+  struct notification *ntfn;
+  uint32_t             bits;
+};
+
+static struct slab_cache *notification_cache;
+
+static struct notification *notification_table[NOTIFICATION_MAX];
+
+static struct notification_irq notification_irqs[NOTIFICATION_IRQ_MAX];
+
+/* Protects both tables */
+static spin_t notification_table_lock;
+
+struct notification *
+notification_create (void)
+{
+  struct notification *ntfn;
+  unsigned int i;
+
+  if ((ntfn = slab_alloc (notification_cache)) == NULL)
+    return NULL;
+
+  memset (ntfn, 0, sizeof (struct notification));
+
+  spin_lock (&notification_table_lock);
+
+  for (i = 0; i < NOTIFICATION_MAX; ++i)
+    if (notification_table[i] == NULL)
+    {
+      ntfn->id              = i;
+      notification_table[i] = ntfn;
+      break;
+    }
+
+  spin_unlock (&notification_table_lock);
+
+  if (i == NOTIFICATION_MAX)
+  {
+    slab_free (notification_cache, ntfn);
+    return NULL;
+  }
+
+  return ntfn;
+}
+
+struct notification *
+notification_lookup (unsigned int id)
+{
+  if (id >= NOTIFICATION_MAX)
+    return NULL;
+
+  return notification_table[id];
+}
+
+void
+notification_signal (struct notification *ntfn, uint32_t bits)
+{
+  struct thread *waiter;
+  uintptr_t flags;
+  int old;
+
+  if (bits == 0)
+    return;
+
+  /* An OR that tells what was there before */
+  do
+    old = ntfn->word;
+  while (a_cas (&ntfn->word, old, old | (int) bits) != old);
+
+  /* Not the zero to non-zero transition: nobody can be waiting */
+  if (old != 0)
+    return;
+
+  flags = spin_lock_irqsave (&ntfn->lock);
+
+  /* A poll may have taken the bits in the meantime: the waiter then
+     stays where it was */
+  if ((waiter = ntfn->waiters) != NULL &&
+      (waiter->ipc_msg[0] = a_swap (&ntfn->word, 0)) != 0)
+  {
+    ntfn->waiters = waiter->ipc_next;
+
+    spin_unlock_irqrestore (&ntfn->lock, flags);
+
+    sched_wakeup (waiter);
+
+    return;
+  }
+
+  spin_unlock_irqrestore (&ntfn->lock, flags);
+}
+
+uint32_t
+notification_poll (struct notification *ntfn)
+{
+  return a_swap (&ntfn->word, 0);
+}
+
+uint32_t
+notification_wait (struct notification *ntfn)
+{
+  struct thread *self = thread_self ();
+  uintptr_t flags;
+  uint32_t bits;
+
+  if ((bits = a_swap (&ntfn->word, 0)) != 0)
+    return bits;
+
+  flags = spin_lock_irqsave (&ntfn->lock);
+
+  /* Checked again with the lock held: a signal making the word
+     non-zero from now on will find us in the queue */
+  if ((bits = a_swap (&ntfn->word, 0)) == 0)
+  {
+    self->ipc_next = NULL;
+
+    if (ntfn->waiters == NULL)
+      ntfn->waiters = self;
+    else
+      ntfn->waiters_tail->ipc_next = self;
+
+    ntfn->waiters_tail = self;
+
+    sched_block (&ntfn->lock);
+
+    bits = self->ipc_msg[0];
+  }
+  else
+    spin_unlock (&ntfn->lock);
+
+  __arch_irq_restore (flags);
+
+  return bits;
+}
+
+/* The device is serviced from userland: keep the line quiet until the
+   driver says it is done */
+static void
+notification_irq_handler (unsigned int irq, void *data)
+{
+  struct notification_irq *binding = (struct notification_irq *) data;
+
+  __arch_irq_mask (irq);
+
+  notification_signal (binding->ntfn, binding->bits);
+}
+
+int
+notification_bind_irq (struct notification *ntfn, unsigned int irq, uint32_t bits)
+{
+  struct notification_irq *binding;
+  int result = -1;
+
+  if (irq >= NOTIFICATION_IRQ_MAX || bits == 0)
+    return -1;
+
+  binding = &notification_irqs[irq];
+
+  spin_lock (&notification_table_lock);
+
+  if (binding->ntfn == NULL)
+  {
+    binding->ntfn = ntfn;
+    binding->bits = bits;
+
+    if ((result = __arch_irq_attach (irq, notification_irq_handler, binding)) != 0)
+      binding->ntfn = NULL;
+  }
+
+  spin_unlock (&notification_table_lock);
+
+  return result;
+}
+
+int
+notification_irq_ack (unsigned int irq)
+{
+  if (irq >= NOTIFICATION_IRQ_MAX || notification_irqs[irq].ntfn == NULL)
+    return -1;
+
+  __arch_irq_unmask (irq);
+
+  return 0;
+}
+
+void
+notification_init (void)
+{
+  if ((notification_cache = slab_cache_create (
+         "notification",
+         sizeof (struct notification),
+         CACHE_LINE_SIZE,
+         0,
+         NULL)) == NULL)
+  {
+    printf ("notification: cannot create notification cache\n");
+    __arch_machine_halt ();
+  }
+}
@@ -0,0 +1,77 @@
+/*
+ *    prof.h: Sampling profiler
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _PROF_H
+#define _PROF_H
+
+#include <atomik/atomik.h>
+
+/* Sample buffer of each CPU, allocated the first time it profiles */
+#define PROF_BUFFER_WORDS 16384
+
+/* Deepest backtrace recorded per sample, interrupted PC included */
+#define PROF_DEPTH_MAX    16
+
+/* Dump format. Everything is made of little-endian 32-bit words:
+
+     struct prof_dump_header
+     for each CPU with samples:
+       struct prof_dump_cpu, followed by WORDS words of samples
+     struct prof_dump_cpu with CPU == PROF_DUMP_END
+
+   Each sample is a count N followed by N addresses, innermost first
+   (the interrupted PC, then return addresses). tools/prof-fold.py turns
+   this into folded stacks. */
+#define PROF_DUMP_MAGIC   "ATMKPROF"
+#define PROF_DUMP_VERSION 1
+#define PROF_DUMP_END     0xffffffff
+
+struct prof_dump_header
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t hz;
+};
+
+struct prof_dump_cpu
+{
+  uint32_t cpu;
+  uint32_t words;
+  uint32_t dropped;  /* Samples lost because the buffer was full */
+};
+
+/* Start sampling the current CPU HZ times per second, recording up to
+   DEPTH frames per sample. Returns -1 if already running, or if the
+   buffer cannot be allocated. */
+int  prof_start (unsigned int, unsigned int);
+
+/* Stop sampling the current CPU. Samples are kept until dumped. */
+void prof_stop (void);
+
+/* Write every buffer to the debug device and empty them. CPUs still
+   sampling are skipped. */
+void prof_dump (void);
+
+/* Profiling from the kernel command line: prof=HZ[,DEPTH]. Every CPU
+   calls prof_init_cpu once it can take timer interrupts, and starts
+   sampling if the option is given. prof_finish stops every CPU and
+   dumps the result; call it with interrupts enabled. */
+void prof_init_cpu (void);
+void prof_finish (void);
+
+#endif /* _PROF_H */
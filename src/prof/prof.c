@@ -0,0 +1,221 @@
+/*
+ *    prof.c: Sampling profiler
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <atomic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <clock.h>
+#include <timer.h>
+#include <prof.h>
+
+/* Only ever written by its own CPU: from prof_start, prof_stop or the
+   timer interrupt */
+struct prof_cpu
+{
+  struct timer timer;
+  uint64_t     period;
+  unsigned int depth;
+  int          running;
+  unsigned int used;
+  uint32_t     dropped;
+  uint32_t    *words;
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static struct prof_cpu prof_cpus[CPU_MAX];
+
+static unsigned int prof_hz;
+
+/* Set by prof_finish: samplers stop at their next tick */
+static volatile int prof_stopping;
+
+static void
+prof_sample (struct timer *timer, void *data)
+{
+  struct prof_cpu *prof = (struct prof_cpu *) data;
+  uintptr_t pcs[PROF_DEPTH_MAX];
+  unsigned int i, n;
+
+  if (prof_stopping)
+  {
+    prof->running = 0;
+    return;
+  }
+
+  if ((n = __arch_irq_backtrace (pcs, prof->depth)) > 0)
+  {
+    if (prof->used + n + 1 > PROF_BUFFER_WORDS)
+      ++prof->dropped;
+    else
+    {
+      prof->words[prof->used++] = n;
+
+      for (i = 0; i < n; ++i)
+        prof->words[prof->used++] = pcs[i];
+    }
+  }
+
+  /* Keep the sampling grid fixed, unless we fell behind it */
+  if (timer->deadline + prof->period > timer_now ())
+    (void) timer_arm (timer, timer->deadline + prof->period);
+  else
+    (void) timer_arm_in (timer, prof->period);
+}
+
+int
+prof_start (unsigned int hz, unsigned int depth)
+{
+  struct prof_cpu *prof = &prof_cpus[__arch_cpu_id ()];
+
+  if (hz == 0 || prof->running)
+    return -1;
+
+  if (prof->words == NULL &&
+      (prof->words = malloc (PROF_BUFFER_WORDS * sizeof (uint32_t))) == NULL)
+    return -1;
+
+  if (depth == 0)
+    depth = 1;
+  else if (depth > PROF_DEPTH_MAX)
+    depth = PROF_DEPTH_MAX;
+
+  prof_hz       = hz;
+  prof->depth   = depth;
+  prof->period  = clock_ns_to_cycles (1000000000ull / hz);
+  prof->running = 1;
+
+  timer_setup (&prof->timer, prof_sample, prof);
+
+  if (timer_arm_in (&prof->timer, prof->period) == -1)
+  {
+    prof->running = 0;
+    return -1;
+  }
+
+  return 0;
+}
+
+void
+prof_stop (void)
+{
+  struct prof_cpu *prof = &prof_cpus[__arch_cpu_id ()];
+
+  if (prof->running)
+  {
+    (void) timer_cancel (&prof->timer);
+    prof->running = 0;
+  }
+}
+
+void
+prof_dump (void)
+{
+  struct prof_dump_header header;
+  struct prof_dump_cpu cpu;
+  unsigned int i;
+
+  /* Don't interleave with pending text */
+  fflush (NULL);
+
+  memcpy (header.magic, PROF_DUMP_MAGIC, sizeof (header.magic));
+  header.version = PROF_DUMP_VERSION;
+  header.hz      = prof_hz;
+
+  __arch_debug_write (&header, sizeof (struct prof_dump_header));
+
+  for (i = 0; i < CPU_MAX; ++i)
+  {
+    if (prof_cpus[i].running || prof_cpus[i].used == 0)
+      continue;
+
+    cpu.cpu     = i;
+    cpu.words   = prof_cpus[i].used;
+    cpu.dropped = prof_cpus[i].dropped;
+
+    __arch_debug_write (&cpu, sizeof (struct prof_dump_cpu));
+    __arch_debug_write (prof_cpus[i].words, cpu.words * sizeof (uint32_t));
+
+    prof_cpus[i].used    = 0;
+    prof_cpus[i].dropped = 0;
+  }
+
+  cpu.cpu     = PROF_DUMP_END;
+  cpu.words   = 0;
+  cpu.dropped = 0;
+
+  __arch_debug_write (&cpu, sizeof (struct prof_dump_cpu));
+}
+
+/* Decimal number at *P, which is left past it. Hand-made: strtoul
+   drags in musl's FILE machinery. */
+static unsigned int
+prof_parse_uint (const char **p)
+{
+  unsigned int value = 0;
+
+  while (**p >= '0' && **p <= '9')
+    value = value * 10 + *(*p)++ - '0';
+
+  return value;
+}
+
+void
+prof_init_cpu (void)
+{
+  const char *option;
+  unsigned int hz, depth = PROF_DEPTH_MAX;
+
+  if ((option = __arch_boot_option ("prof")) == NULL)
+    return;
+
+  hz = prof_parse_uint (&option);
+
+  if (*option == ',')
+  {
+    ++option;
+    depth = prof_parse_uint (&option);
+  }
+
+  if (prof_start (hz, depth) == -1)
+    printf ("prof: cannot start profiling CPU %u\n", __arch_cpu_id ());
+}
+
+void
+prof_finish (void)
+{
+  unsigned int i;
+
+  if (prof_hz == 0)
+    return;
+
+  prof_stopping = 1;
+
+  /* Every sampler sees the flag within a period. Ours too: interrupts
+     are enabled. */
+  for (i = 0; i < CPU_MAX; ++i)
+    while (prof_cpus[i].running)
+      a_spin ();
+
+  prof_dump ();
+
+  prof_stopping = 0;
+}
@@ -0,0 +1,97 @@
+/*
+ *    sched.h: Fixed-priority scheduler
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <atomik/atomik.h>
+#include <spinlock.h>
+
+#include <thread.h>
+
+#define SCHED_PRIORITIES        256
+#define SCHED_PRIORITY_MAX      0   /* Most urgent */
+#define SCHED_PRIORITY_MIN      (SCHED_PRIORITIES - 1)
+#define SCHED_PRIORITY_DEFAULT  128
+
+/* Round robin quantum among threads of the same priority */
+#define SCHED_TIMESLICE_NS      10000000
+
+#define SCHED_BITMAP_WORDS      (SCHED_PRIORITIES / 32)
+
+/* Two-level bitmap: bit P of BITMAP is set iff level P has threads, and
+   bit W of SUMMARY iff BITMAP[W] is not zero. Lower levels win. There
+   is one per CPU. */
+struct sched_runqueue
+{
+  spin_t         lock;
+  unsigned int   ready;     /* Threads queued, for thieves to compare */
+  uint32_t       summary;
+  uint32_t       bitmap[SCHED_BITMAP_WORDS];
+  struct thread *queues[SCHED_PRIORITIES];  /* Head of each FIFO */
+};
+
+/* Turn the boot context into the idle thread of this CPU */
+void sched_init (void);
+
+/* Same, for the other CPUs, once sched_init is done */
+void sched_init_cpu (void);
+
+/* Body of the idle thread: drain the log, sleep, run whatever wakes up */
+void sched_idle (void) __attribute__ ((noreturn));
+
+struct thread *sched_current (void);
+
+/* Make a blocked (or new) thread ready. Preempts the current one at the
+   next preemption point if the woken thread is more urgent. Callable
+   from interrupt context. */
+void sched_wakeup (struct thread *);
+
+/* Block the current thread until sched_wakeup. If LOCK is not NULL, it
+   is released once a concurrent wakeup can no longer be missed: take it
+   before checking the wait condition. */
+void sched_block (spin_t *);
+
+/* Block the current thread like sched_block, and run NEXT right away
+   on this CPU, without going through any run queue: a direct switch
+   for synchronous IPC. NEXT must be blocked, and the caller must be the
+   only one who may wake it. Falls back to a wakeup if NEXT may not run
+   here or a more urgent thread is ready. */
+void sched_handoff (spin_t *, struct thread *);
+
+/* Go to the back of the current priority level */
+void sched_yield (void);
+
+/* Restrict THREAD to the CPUs in MASK (see THREAD_AFFINITY_ALL). By
+   default, threads stay on the CPU they last ran on unless another one
+   is idle. A ready thread is moved right away, and so is the caller.
+   If THREAD runs on another CPU, that CPU is kicked and lets it go at
+   its next switch (from userland, the kick itself); if blocked, it is
+   moved when woken up. Returns -1 if no CPU in MASK is online. */
+int  sched_set_affinity (struct thread *, unsigned int);
+
+/* Print per-CPU scheduling statistics */
+void sched_dump (void);
+
+/* Called by thread_exit */
+void sched_exit (void) __attribute__ ((noreturn));
+
+/* First code run by every new thread (see thread_create) */
+void sched_thread_start (void *) __attribute__ ((noreturn));
+
+#endif /* _SCHED_H */
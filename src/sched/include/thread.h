@@ -0,0 +1,95 @@
+/*
+ *    thread.h: Kernel threads
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _THREAD_H
+#define _THREAD_H
+
+#include <atomik/atomik.h>
+#include <atomik/ipc.h>
+#include <spinlock.h>
+
+/* Kernel stacks are 2^THREAD_STACK_ORDER frames */
+#define THREAD_STACK_ORDER 1
+
+#define THREAD_NAME_MAX    16
+
+/* Affinity mask allowing every CPU */
+#define THREAD_AFFINITY_ALL (~0u)
+
+enum thread_state
+{
+  THREAD_READY,    /* In a run queue */
+  THREAD_RUNNING,
+  THREAD_BLOCKED,  /* Waiting for sched_wakeup (new threads too) */
+  THREAD_DEAD      /* Waiting to be reaped by the next thread */
+};
+
+struct thread
+{
+  uintptr_t      context;   /* Saved stack pointer, see __arch_context_switch */
+
+  /* Run queue links: circular, doubly linked */
+  struct thread *next;
+  struct thread *prev;
+
+  unsigned int   priority;  /* 0 is the most urgent */
+  unsigned int   state;
+  unsigned int   cpu;       /* Last CPU it ran on, or queued at */
+  unsigned int   affinity;  /* Bit N set: may run on CPU N */
+  volatile int   on_cpu;    /* Context not saved yet */
+
+  uintptr_t      stack;     /* Kernel stack frames, 0 for boot threads */
+  void          *fpu;       /* See __arch_fpu_switch */
+
+  void         (*entry) (void *);
+  void          *arg;
+
+  /* IPC state, see endpoint.h */
+  spin_t         ipc_lock;    /* Held by whoever delivers a reply */
+  struct thread *ipc_next;    /* Endpoint wait queue link */
+  struct thread *ipc_caller;  /* Blocked in a call, waiting for our reply */
+  int            ipc_call;    /* Blocked sending: wants a reply too */
+  uintptr_t      ipc_msg[IPC_MSG_WORDS];
+
+  char           name[THREAD_NAME_MAX];
+};
+
+static inline uintptr_t
+thread_stack_top (const struct thread *thread)
+{
+  return (uintptr_t) PHYS_TO_VIRT (thread->stack) + (PAGE_SIZE << THREAD_STACK_ORDER);
+}
+
+/* Create a thread running ENTRY (ARG) at PRIORITY and make it ready.
+   Returning from ENTRY is the same as calling thread_exit. */
+struct thread *thread_create (const char *, void (*) (void *), void *, unsigned int);
+
+/* Thread structure for the context we are already running in (boot
+   code), without a stack of its own */
+struct thread *thread_adopt (const char *, unsigned int);
+
+void thread_exit (void) __attribute__ ((noreturn));
+
+/* Release a dead thread. Never on the thread itself. */
+void thread_destroy (struct thread *);
+
+struct thread *thread_self (void);
+
+void thread_init (void);
+
+#endif /* _THREAD_H */
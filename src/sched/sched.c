@@ -0,0 +1,839 @@
+/*
+ *    sched.c: Fixed-priority scheduler
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <atomic.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+
+#include <clock.h>
+#include <klog.h>
+#include <timer.h>
+#include <sched.h>
+#include <thread.h>
+
+/* Reasons for a pending reschedule, most important last */
+#define SCHED_RESCHED_NONE    0
+#define SCHED_RESCHED_SLICE   1 /* Quantum over: back of the queue */
+#define SCHED_RESCHED_PREEMPT 2 /* More urgent thread: front of the queue */
+
+/* Each CPU schedules from its own run queue. Threads go back to the
+   CPU they last ran on, and only move when a CPU with nothing to do
+   steals them, or when their affinity says so. Locks nest in a single
+   direction: a CPU may only try (never wait for) another run queue's
+   lock while holding its own. */
+struct sched_cpu
+{
+  struct sched_runqueue rq;
+  struct thread        *current;
+  struct thread        *idle;
+  struct thread        *prev;         /* Thread we switched away from */
+  struct thread        *migrate;      /* PREV, if it may not run here */
+  int                   need_resched;
+  int                   slice_check;  /* Remote wakeup: review the quantum */
+  unsigned long         switches;
+  unsigned long         steals;
+  struct timer          slice;
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static struct sched_cpu sched_cpus[CPU_MAX];
+
+/* Bit N is set while CPU N runs its idle thread */
+static volatile int sched_idle_cpus;
+
+static uint64_t sched_slice_cycles;
+
+/* Run queue primitives. O(1), the run queue lock must be held. */
+static inline void
+sched_rq_mark (struct sched_runqueue *rq, unsigned int prio)
+{
+  rq->bitmap[prio >> 5] |= 1u << (prio & 31);
+  rq->summary           |= 1u << (prio >> 5);
+}
+
+static inline void
+sched_rq_unmark (struct sched_runqueue *rq, unsigned int prio)
+{
+  if ((rq->bitmap[prio >> 5] &= ~(1u << (prio & 31))) == 0)
+    rq->summary &= ~(1u << (prio >> 5));
+}
+
+static inline void
+sched_rq_insert (struct sched_runqueue *rq, struct thread *thread)
+{
+  struct thread **head = &rq->queues[thread->priority];
+
+  if (*head == NULL)
+  {
+    thread->next = thread->prev = thread;
+    *head = thread;
+
+    sched_rq_mark (rq, thread->priority);
+  }
+  else
+  {
+    thread->next       = *head;
+    thread->prev       = (*head)->prev;
+    thread->prev->next = thread;
+    (*head)->prev      = thread;
+  }
+
+  ++rq->ready;
+}
+
+/* At the back of its level */
+static inline void
+sched_rq_enqueue (struct sched_runqueue *rq, struct thread *thread)
+{
+  thread->state = THREAD_READY;
+
+  sched_rq_insert (rq, thread);
+}
+
+/* At the front: it was preempted, not done with its quantum */
+static inline void
+sched_rq_enqueue_head (struct sched_runqueue *rq, struct thread *thread)
+{
+  thread->state = THREAD_READY;
+
+  sched_rq_insert (rq, thread);
+
+  rq->queues[thread->priority] = thread;
+}
+
+static inline void
+sched_rq_dequeue (struct sched_runqueue *rq, struct thread *thread)
+{
+  struct thread **head = &rq->queues[thread->priority];
+
+  if (thread->next == thread)
+  {
+    *head = NULL;
+
+    sched_rq_unmark (rq, thread->priority);
+  }
+  else
+  {
+    thread->prev->next = thread->next;
+    thread->next->prev = thread->prev;
+
+    if (*head == thread)
+      *head = thread->next;
+  }
+
+  --rq->ready;
+}
+
+/* Most urgent ready thread, or NULL: two BSF, whatever the load */
+static inline struct thread *
+sched_rq_peek (const struct sched_runqueue *rq)
+{
+  unsigned int word;
+
+  if (rq->summary == 0)
+    return NULL;
+
+  word = a_ctz_l (rq->summary);
+
+  return rq->queues[(word << 5) + a_ctz_l (rq->bitmap[word])];
+}
+
+static inline int
+sched_more_urgent (const struct thread *a, const struct thread *b)
+{
+  return a->priority < b->priority;
+}
+
+static inline unsigned int
+sched_online_mask (void)
+{
+  return (1u << __arch_cpu_count ()) - 1;
+}
+
+static inline int
+sched_cpu_allowed (const struct thread *thread, unsigned int cpu)
+{
+  return (thread->affinity & sched_online_mask () & (1u << cpu)) != 0;
+}
+
+/* Whether THREAD is in RQ. Not O(1), but only affinity changes use
+   it. */
+static int
+sched_rq_queued (const struct sched_runqueue *rq, const struct thread *thread)
+{
+  const struct thread *head = rq->queues[thread->priority];
+  const struct thread *p;
+
+  if ((p = head) != NULL)
+    do
+      if (p == thread)
+        return 1;
+    while ((p = p->next) != head);
+
+  return 0;
+}
+
+/* Most urgent ready thread that may run on CPU. Not O(1), but only
+   thieves use it. */
+static struct thread *
+sched_rq_find (const struct sched_runqueue *rq, unsigned int cpu)
+{
+  struct thread *head;
+  struct thread *thread;
+  unsigned int summary;
+  unsigned int bits;
+  unsigned int word;
+
+  for (summary = rq->summary; summary != 0; summary &= summary - 1)
+  {
+    word = a_ctz_l (summary);
+
+    for (bits = rq->bitmap[word]; bits != 0; bits &= bits - 1)
+    {
+      head = thread = rq->queues[(word << 5) + a_ctz_l (bits)];
+
+      do
+        if (sched_cpu_allowed (thread, cpu))
+          return thread;
+      while ((thread = thread->next) != head);
+    }
+  }
+
+  return NULL;
+}
+
+static struct sched_cpu *
+sched_this_cpu (void)
+{
+  return &sched_cpus[__arch_cpu_id ()];
+}
+
+static inline unsigned int
+sched_cpu_index (const struct sched_cpu *cpu)
+{
+  return cpu - sched_cpus;
+}
+
+/* Where THREAD should be queued: the CPU it last ran on, if allowed */
+static struct sched_cpu *
+sched_home (const struct thread *thread)
+{
+  if (sched_cpu_allowed (thread, thread->cpu))
+    return &sched_cpus[thread->cpu];
+
+  return &sched_cpus[a_ctz_l (thread->affinity & sched_online_mask ())];
+}
+
+static void
+sched_slice_expired (struct timer *timer, void *data)
+{
+  struct sched_cpu *cpu = (struct sched_cpu *) data;
+
+  if (cpu->need_resched < SCHED_RESCHED_SLICE)
+    cpu->need_resched = SCHED_RESCHED_SLICE;
+}
+
+/* Quanta only matter if someone else is waiting at the same level.
+   Timers are per CPU: only for the calling CPU. */
+static void
+sched_slice_update (struct sched_cpu *cpu, struct thread *thread)
+{
+  if (thread != cpu->idle && cpu->rq.queues[thread->priority] != NULL)
+  {
+    if (!timer_pending (&cpu->slice))
+      (void) timer_arm_in (&cpu->slice, sched_slice_cycles);
+  }
+  else if (timer_pending (&cpu->slice))
+    (void) timer_cancel (&cpu->slice);
+}
+
+/* Have an idle CPU that may run THREAD go and steal it. Returns
+   nonzero if there was one. */
+static int
+sched_kick_idle (const struct thread *thread)
+{
+  unsigned int self = __arch_cpu_id ();
+  unsigned int idle;
+  unsigned int target;
+
+  idle = sched_idle_cpus & thread->affinity & sched_online_mask ()
+    & ~(1u << self);
+
+  if (idle == 0)
+    return 0;
+
+  target = a_ctz_l (idle);
+
+  sched_cpus[target].need_resched = SCHED_RESCHED_PREEMPT;
+
+  __arch_cpu_kick (target);
+
+  return 1;
+}
+
+/* THREAD was just queued on TARGET, whose lock is held: see who should
+   run it, and when */
+static void
+sched_ready (struct sched_cpu *target, struct thread *thread)
+{
+  struct sched_cpu *self = sched_this_cpu ();
+
+  if (target->current == target->idle ||
+      sched_more_urgent (thread, target->current))
+  {
+    target->need_resched = SCHED_RESCHED_PREEMPT;
+
+    if (target != self)
+      __arch_cpu_kick (sched_cpu_index (target));
+  }
+  else if (!sched_kick_idle (thread))
+  {
+    if (target == self)
+      sched_slice_update (target, target->current);
+    else
+    {
+      target->slice_check = 1;
+
+      __arch_cpu_kick (sched_cpu_index (target));
+    }
+  }
+}
+
+/* Lock the run queue of THREAD's CPU, which may change until then */
+static struct sched_cpu *
+sched_lock_cpu_of (const struct thread *thread)
+{
+  struct sched_cpu *cpu;
+
+  for (;;)
+  {
+    cpu = &sched_cpus[thread->cpu];
+
+    spin_lock (&cpu->rq.lock);
+
+    if (cpu == &sched_cpus[thread->cpu])
+      return cpu;
+
+    spin_unlock (&cpu->rq.lock);
+  }
+}
+
+/* Queue a ready thread on its home CPU. No run queue lock held. */
+static void
+sched_push (struct thread *thread)
+{
+  struct sched_cpu *target;
+
+  /* A queued thread is always in the run queue of its CPU, which is
+     where sched_set_affinity looks for it. The barrier in a_store
+     makes sure that, if it did not find it there, we see its new
+     mask. */
+  for (;;)
+  {
+    target = sched_home (thread);
+
+    spin_lock (&target->rq.lock);
+
+    a_store ((volatile int *) &thread->cpu, sched_cpu_index (target));
+
+    if (sched_cpu_allowed (thread, sched_cpu_index (target)))
+      break;
+
+    spin_unlock (&target->rq.lock);
+  }
+
+  sched_rq_enqueue (&target->rq, thread);
+
+  sched_ready (target, thread);
+
+  spin_unlock (&target->rq.lock);
+}
+
+/* Put the current thread back in the run queue before switching away.
+   If it may no longer run here, it is pushed to another CPU once
+   switched out (see sched_finish). */
+static void
+sched_requeue (struct sched_cpu *cpu, struct thread *thread, int head)
+{
+  if (!sched_cpu_allowed (thread, sched_cpu_index (cpu)))
+  {
+    thread->state = THREAD_READY;
+    cpu->migrate  = thread;
+  }
+  else if (head)
+    sched_rq_enqueue_head (&cpu->rq, thread);
+  else
+    sched_rq_enqueue (&cpu->rq, thread);
+}
+
+/* Nothing to run here: take the most urgent thread we may run from the
+   CPU with most of them waiting. Its lock is only tried, as its owner
+   may be trying ours: whoever fails just tries again next time. */
+static struct thread *
+sched_steal (struct sched_cpu *cpu)
+{
+  unsigned int count = __arch_cpu_count ();
+  struct sched_cpu *victim = NULL;
+  struct thread *thread;
+  unsigned int busiest = 0;
+  unsigned int i;
+
+  for (i = 0; i < count; ++i)
+    if (&sched_cpus[i] != cpu && sched_cpus[i].rq.ready > busiest)
+    {
+      busiest = sched_cpus[i].rq.ready;
+      victim  = &sched_cpus[i];
+    }
+
+  if (victim == NULL || !spin_trylock (&victim->rq.lock))
+    return NULL;
+
+  if ((thread = sched_rq_find (&victim->rq, sched_cpu_index (cpu))) != NULL)
+  {
+    sched_rq_dequeue (&victim->rq, thread);
+
+    /* Ours from now on: our lock is held until it runs */
+    thread->cpu = sched_cpu_index (cpu);
+
+    ++cpu->steals;
+  }
+
+  spin_unlock (&victim->rq.lock);
+
+  return thread;
+}
+
+/* Take the next thread to run out of the run queue */
+static struct thread *
+sched_pick (struct sched_cpu *cpu)
+{
+  struct thread *next;
+
+  if ((next = sched_rq_peek (&cpu->rq)) != NULL)
+  {
+    sched_rq_dequeue (&cpu->rq, next);
+
+    return next;
+  }
+
+  if ((next = sched_steal (cpu)) != NULL)
+    return next;
+
+  return cpu->idle;
+}
+
+/* Run queue lock held, interrupts disabled. Returns once the current
+   thread is switched back in, with the lock of the CPU it is then
+   running on held. */
+static void
+sched_switch (struct sched_cpu *cpu, struct thread *next)
+{
+  struct thread *prev = cpu->current;
+  unsigned int self = sched_cpu_index (cpu);
+
+  cpu->need_resched = SCHED_RESCHED_NONE;
+
+  next->state = THREAD_RUNNING;
+  next->cpu   = self;
+
+  sched_slice_update (cpu, next);
+
+  if (next == prev)
+    return;
+
+  if (next == cpu->idle)
+    a_or (&sched_idle_cpus, 1 << self);
+  else if (prev == cpu->idle)
+    a_and (&sched_idle_cpus, ~(1 << self));
+
+  /* Woken or stolen while its old CPU was still switching away from
+     it: its context is not saved yet */
+  while (next->on_cpu)
+    a_spin ();
+
+  next->on_cpu = 1;
+
+  ++cpu->switches;
+
+  cpu->current = next;
+  cpu->prev    = prev;
+
+  if (next->stack != 0)
+    __arch_set_kernel_stack (thread_stack_top (next));
+
+  /* The next CPU to pick PREV may not be this one */
+  if (prev->state != THREAD_DEAD)
+    __arch_fpu_flush (&prev->fpu);
+
+  __arch_fpu_switch (&next->fpu);
+
+  __arch_context_switch (&prev->context, next->context);
+}
+
+/* Counterpart of sched_switch, run by whichever thread got switched in:
+   lets other CPUs run the previous thread, releases the run queue lock
+   and reaps the previous thread if dead */
+static void
+sched_finish (void)
+{
+  struct sched_cpu *cpu = sched_this_cpu ();
+  struct thread *migrate = cpu->migrate;
+  struct thread *dead = NULL;
+
+  if (cpu->prev != NULL)
+  {
+    if (cpu->prev->state == THREAD_DEAD)
+      dead = cpu->prev;
+
+    a_store (&cpu->prev->on_cpu, 0);
+  }
+
+  cpu->prev    = NULL;
+  cpu->migrate = NULL;
+
+  spin_unlock (&cpu->rq.lock);
+
+  if (migrate != NULL)
+    sched_push (migrate);
+
+  if (dead != NULL)
+    thread_destroy (dead);
+}
+
+void
+sched_thread_start (void *arg)
+{
+  struct thread *self = (struct thread *) arg;
+
+  sched_finish ();
+
+  __arch_irq_enable ();
+
+  (self->entry) (self->arg);
+
+  thread_exit ();
+}
+
+struct thread *
+sched_current (void)
+{
+  return sched_this_cpu ()->current;
+}
+
+void
+sched_wakeup (struct thread *thread)
+{
+  struct sched_cpu *home;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  /* The CPU of a blocked thread does not change, and it blocked with
+     that CPU's lock held. Otherwise, it is not blocked anyway. */
+  home = sched_lock_cpu_of (thread);
+
+  if (thread->state != THREAD_BLOCKED)
+    spin_unlock (&home->rq.lock);
+  else if (sched_home (thread) == home)
+  {
+    sched_rq_enqueue (&home->rq, thread);
+
+    sched_ready (home, thread);
+
+    spin_unlock (&home->rq.lock);
+  }
+  else
+  {
+    /* Its affinity changed while blocked. READY keeps other wakeups
+       away in the meantime. */
+    thread->state = THREAD_READY;
+
+    spin_unlock (&home->rq.lock);
+
+    sched_push (thread);
+  }
+
+  __arch_irq_restore (flags);
+}
+
+void
+sched_block (spin_t *lock)
+{
+  struct sched_cpu *cpu;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = sched_this_cpu ();
+
+  spin_lock (&cpu->rq.lock);
+
+  cpu->current->state = THREAD_BLOCKED;
+
+  if (lock != NULL)
+    spin_unlock (lock);
+
+  sched_switch (cpu, sched_pick (cpu));
+
+  sched_finish ();
+
+  __arch_irq_restore (flags);
+}
+
+void
+sched_handoff (spin_t *lock, struct thread *next)
+{
+  struct sched_cpu *cpu;
+  struct thread *ready;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = sched_this_cpu ();
+
+  if (!sched_cpu_allowed (next, sched_cpu_index (cpu)))
+  {
+    sched_wakeup (next);
+
+    sched_block (lock);
+
+    __arch_irq_restore (flags);
+
+    return;
+  }
+
+  spin_lock (&cpu->rq.lock);
+
+  cpu->current->state = THREAD_BLOCKED;
+
+  if (lock != NULL)
+    spin_unlock (lock);
+
+  /* Nobody else can wake NEXT, so queueing it here is safe */
+  if ((ready = sched_rq_peek (&cpu->rq)) != NULL && sched_more_urgent (ready, next))
+  {
+    next->cpu = sched_cpu_index (cpu);
+
+    sched_rq_enqueue (&cpu->rq, next);
+
+    next = sched_pick (cpu);
+  }
+
+  sched_switch (cpu, next);
+
+  sched_finish ();
+
+  __arch_irq_restore (flags);
+}
+
+void
+sched_yield (void)
+{
+  struct sched_cpu *cpu;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  cpu = sched_this_cpu ();
+
+  spin_lock (&cpu->rq.lock);
+
+  if (cpu->current != cpu->idle)
+    sched_requeue (cpu, cpu->current, 0);
+
+  sched_switch (cpu, sched_pick (cpu));
+
+  sched_finish ();
+
+  __arch_irq_restore (flags);
+}
+
+void
+sched_exit (void)
+{
+  struct sched_cpu *cpu;
+
+  (void) __arch_irq_save ();
+
+  cpu = sched_this_cpu ();
+
+  spin_lock (&cpu->rq.lock);
+
+  cpu->current->state = THREAD_DEAD;
+
+  sched_switch (cpu, sched_pick (cpu));
+
+  /* Not reached: the next thread reaps us */
+  for (;;);
+}
+
+int
+sched_set_affinity (struct thread *thread, unsigned int mask)
+{
+  struct sched_cpu *home;
+  uintptr_t flags;
+  int push = 0;
+
+  if ((mask & sched_online_mask ()) == 0)
+    return -1;
+
+  flags = __arch_irq_save ();
+
+  /* Before taking the lock: see sched_push */
+  thread->affinity = mask;
+
+  home = sched_lock_cpu_of (thread);
+
+  if (!sched_cpu_allowed (thread, sched_cpu_index (home)))
+  {
+    if (thread->state == THREAD_READY && sched_rq_queued (&home->rq, thread))
+    {
+      sched_rq_dequeue (&home->rq, thread);
+
+      push = 1;
+    }
+    else if (thread->state == THREAD_RUNNING &&
+             home->current == thread &&
+             home != sched_this_cpu ())
+    {
+      home->need_resched = SCHED_RESCHED_PREEMPT;
+
+      __arch_cpu_kick (sched_cpu_index (home));
+    }
+  }
+
+  spin_unlock (&home->rq.lock);
+
+  if (push)
+    sched_push (thread);
+  else if (thread == sched_current () &&
+           !sched_cpu_allowed (thread, __arch_cpu_id ()))
+    sched_yield ();
+
+  __arch_irq_restore (flags);
+
+  return 0;
+}
+
+/* Interrupt exit. Kernel code is not preemptible (it may hold plain
+   spinlocks), so only userland and the idle thread are switched away
+   from here; kernel threads get the CPU back at their next sched_yield
+   or sched_block. */
+static void
+sched_preempt (int from_user)
+{
+  struct sched_cpu *cpu = sched_this_cpu ();
+  struct thread *current = cpu->current;
+
+  if (cpu->slice_check)
+  {
+    cpu->slice_check = 0;
+
+    spin_lock (&cpu->rq.lock);
+
+    sched_slice_update (cpu, current);
+
+    spin_unlock (&cpu->rq.lock);
+  }
+
+  if (cpu->need_resched == SCHED_RESCHED_NONE ||
+      (!from_user && current != cpu->idle))
+    return;
+
+  spin_lock (&cpu->rq.lock);
+
+  if (current != cpu->idle)
+    sched_requeue (cpu, current, cpu->need_resched == SCHED_RESCHED_PREEMPT);
+
+  sched_switch (cpu, sched_pick (cpu));
+
+  sched_finish ();
+}
+
+void
+sched_idle (void)
+{
+  struct sched_cpu *cpu;
+  uintptr_t flags;
+
+  for (;;)
+  {
+    klog_drain ();
+
+    flags = __arch_irq_save ();
+
+    cpu = sched_this_cpu ();
+
+    if (cpu->need_resched != SCHED_RESCHED_NONE)
+    {
+      __arch_irq_restore (flags);
+
+      sched_yield ();
+    }
+    else
+      __arch_idle ();
+  }
+}
+
+void
+sched_dump (void)
+{
+  unsigned int count = __arch_cpu_count ();
+  unsigned int i;
+
+  for (i = 0; i < count; ++i)
+    printf ("sched: CPU %u: %u ready, %lu switches, %lu steals\n",
+            i,
+            sched_cpus[i].rq.ready,
+            sched_cpus[i].switches,
+            sched_cpus[i].steals);
+}
+
+void
+sched_init_cpu (void)
+{
+  struct sched_cpu *cpu = sched_this_cpu ();
+  unsigned int self = sched_cpu_index (cpu);
+
+  if ((cpu->idle = thread_adopt ("idle", SCHED_PRIORITY_MIN)) == NULL)
+  {
+    printf ("sched: cannot create idle thread\n");
+    __arch_machine_halt ();
+  }
+
+  cpu->idle->affinity = 1u << self;
+  cpu->current        = cpu->idle;
+
+  timer_setup (&cpu->slice, sched_slice_expired, cpu);
+
+  a_or (&sched_idle_cpus, 1 << self);
+}
+
+void
+sched_init (void)
+{
+  thread_init ();
+
+  sched_slice_cycles = clock_ns_to_cycles (SCHED_TIMESLICE_NS);
+
+  sched_init_cpu ();
+
+  __arch_preempt_init (sched_preempt);
+}
@@ -0,0 +1,139 @@
+/*
+ *    thread.c: Kernel threads
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <frame.h>
+#include <slab.h>
+#include <sched.h>
+#include <thread.h>
+
+static struct slab_cache *thread_cache;
+
+static void
+thread_set_name (struct thread *thread, const char *name)
+{
+  strncpy (thread->name, name, THREAD_NAME_MAX - 1);
+  thread->name[THREAD_NAME_MAX - 1] = '\0';
+}
+
+static struct thread *
+thread_alloc (const char *name, unsigned int priority)
+{
+  struct thread *thread;
+
+  if (priority >= SCHED_PRIORITIES)
+    return NULL;
+
+  if ((thread = slab_alloc (thread_cache)) == NULL)
+    return NULL;
+
+  memset (thread, 0, sizeof (struct thread));
+
+  thread->priority = priority;
+  thread->state    = THREAD_BLOCKED;
+  thread->cpu      = __arch_cpu_id ();
+  thread->affinity = THREAD_AFFINITY_ALL;
+
+  thread_set_name (thread, name);
+
+  return thread;
+}
+
+struct thread *
+thread_create (const char *name, void (*entry) (void *), void *arg, unsigned int priority)
+{
+  struct thread *thread;
+
+  if ((thread = thread_alloc (name, priority)) == NULL)
+    return NULL;
+
+  if ((thread->stack = frame_alloc_pages (THREAD_STACK_ORDER)) == FRAME_INVALID)
+  {
+    slab_free (thread_cache, thread);
+    return NULL;
+  }
+
+  thread->entry   = entry;
+  thread->arg     = arg;
+  thread->context = __arch_context_init (
+    PHYS_TO_VIRT (thread->stack),
+    PAGE_SIZE << THREAD_STACK_ORDER,
+    sched_thread_start,
+    thread);
+
+  sched_wakeup (thread);
+
+  return thread;
+}
+
+struct thread *
+thread_adopt (const char *name, unsigned int priority)
+{
+  struct thread *thread;
+
+  if ((thread = thread_alloc (name, priority)) != NULL)
+  {
+    thread->state  = THREAD_RUNNING;
+    thread->on_cpu = 1;
+  }
+
+  return thread;
+}
+
+void
+thread_exit (void)
+{
+  sched_exit ();
+}
+
+void
+thread_destroy (struct thread *thread)
+{
+  __arch_fpu_free (&thread->fpu);
+
+  if (thread->stack != 0)
+    frame_free_pages (thread->stack, THREAD_STACK_ORDER);
+
+  slab_free (thread_cache, thread);
+}
+
+struct thread *
+thread_self (void)
+{
+  return sched_current ();
+}
+
+void
+thread_init (void)
+{
+  if ((thread_cache = slab_cache_create (
+         "thread",
+         sizeof (struct thread),
+         CACHE_LINE_SIZE,
+         0,
+         NULL)) == NULL)
+  {
+    printf ("thread: cannot create thread cache\n");
+    __arch_machine_halt ();
+  }
+}
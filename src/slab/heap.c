@@ -0,0 +1,184 @@
+/*
+ *    heap.c: Kernel heap (malloc and friends)
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <frame.h>
+#include <slab.h>
+#include <heap.h>
+
+/* Odd, so it never matches the (aligned) cache pointer a slab starts with */
+#define HEAP_LARGE_MAGIC 0x4c524745
+
+#define HEAP_MIN_SIZE    (1 << HEAP_MIN_SHIFT)
+#define HEAP_MAX_SIZE    (1 << HEAP_MAX_SHIFT)
+
+/* Large allocations are frame runs starting with this header. Small ones
+   live in single-frame slabs, so the frame an object lives in always
+   tells how it was allocated. */
+struct heap_large
+{
+  uint32_t     magic;
+  unsigned int order;
+  size_t       size;
+  uint32_t     reserved;  /* Keeps the payload HEAP_ALIGN-aligned */
+};
+
+static struct slab_cache *heap_classes[HEAP_CLASSES];
+
+static const char *heap_class_names[HEAP_CLASSES] =
+{
+  "heap-16", "heap-32", "heap-64", "heap-128", "heap-256", "heap-512", "heap-1024"
+};
+
+static void *
+heap_alloc_large (size_t size)
+{
+  struct heap_large *large;
+  uintptr_t frame;
+  size_t pages;
+  unsigned int order;
+
+  if (size > SIZE_MAX - sizeof (struct heap_large) - PAGE_SIZE)
+    return NULL;
+
+  pages = __UNITS (size + sizeof (struct heap_large), PAGE_SIZE);
+
+  for (order = 0; (1 << order) < pages; ++order)
+    if (order == FRAME_MAX_ORDER)
+      return NULL;
+
+  if ((frame = frame_alloc_pages (order)) == FRAME_INVALID)
+    return NULL;
+
+  large = (struct heap_large *) PHYS_TO_VIRT (frame);
+
+  large->magic = HEAP_LARGE_MAGIC;
+  large->order = order;
+  large->size  = size;
+
+  return large + 1;
+}
+
+static size_t
+heap_usable_size (void *ptr)
+{
+  struct heap_large *large = (struct heap_large *) PAGE_START ((uintptr_t) ptr);
+
+  if (large->magic == HEAP_LARGE_MAGIC)
+    return (PAGE_SIZE << large->order) - sizeof (struct heap_large);
+
+  return slab_cache_of (ptr)->size;
+}
+
+void *
+malloc (size_t size)
+{
+  unsigned int class;
+
+  if (size > HEAP_MAX_SIZE)
+    return heap_alloc_large (size);
+
+  for (class = 0; (HEAP_MIN_SIZE << class) < size; ++class);
+
+  if (heap_classes[class] == NULL)
+    return NULL;
+
+  return slab_alloc (heap_classes[class]);
+}
+
+void
+free (void *ptr)
+{
+  struct heap_large *large;
+
+  if (ptr == NULL)
+    return;
+
+  large = (struct heap_large *) PAGE_START ((uintptr_t) ptr);
+
+  if (large->magic == HEAP_LARGE_MAGIC)
+  {
+    large->magic = 0;
+    frame_free_pages (VIRT_TO_PHYS (large), large->order);
+  }
+  else
+    slab_free (slab_cache_of (ptr), ptr);
+}
+
+void *
+calloc (size_t count, size_t size)
+{
+  void *ptr;
+
+  if (size != 0 && count > SIZE_MAX / size)
+    return NULL;
+
+  if ((ptr = malloc (count * size)) != NULL)
+    memset (ptr, 0, count * size);
+
+  return ptr;
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  void *new;
+  size_t old_size;
+
+  if (ptr == NULL)
+    return malloc (size);
+
+  if (size == 0)
+  {
+    free (ptr);
+    return NULL;
+  }
+
+  old_size = heap_usable_size (ptr);
+
+  if (size <= old_size)
+    return ptr;
+
+  if ((new = malloc (size)) == NULL)
+    return NULL;
+
+  memcpy (new, ptr, old_size);
+
+  free (ptr);
+
+  return new;
+}
+
+void
+heap_init (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < HEAP_CLASSES; ++i)
+    heap_classes[i] = slab_cache_create (
+      heap_class_names[i],
+      HEAP_MIN_SIZE << i,
+      HEAP_ALIGN,
+      SLAB_SINGLE_FRAME,
+      NULL);
+}
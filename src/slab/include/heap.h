@@ -0,0 +1,35 @@
+/*
+ *    heap.h: Kernel heap (malloc and friends)
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _HEAP_H
+#define _HEAP_H
+
+#include <stdlib.h>
+
+/* Size classes are powers of two from 2^HEAP_MIN_SHIFT to 2^HEAP_MAX_SHIFT
+   bytes. Anything bigger goes straight to the frame allocator. */
+#define HEAP_MIN_SHIFT 4
+#define HEAP_MAX_SHIFT 10
+#define HEAP_CLASSES   (HEAP_MAX_SHIFT - HEAP_MIN_SHIFT + 1)
+
+#define HEAP_ALIGN     16
+
+/* Create the size class caches. malloc fails until this is called. */
+void heap_init (void);
+
+#endif /* _HEAP_H */
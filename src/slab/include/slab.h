@@ -0,0 +1,101 @@
+/*
+ *    slab.h: Object caches for fixed-size kernel objects
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <atomik/atomik.h>
+#include <spinlock.h>
+
+#define SLAB_MAX_ORDER     3
+
+/* A magazine fills exactly one cache line */
+#define SLAB_MAGAZINE_SIZE (CACHE_LINE_SIZE / sizeof (void *) - 1)
+
+/* Objects moved at once between a magazine and the slabs */
+#define SLAB_BATCH         (SLAB_MAGAZINE_SIZE / 2 + 1)
+
+/* Cache flags */
+#define SLAB_SINGLE_FRAME  1 /* Slabs are one frame long: see slab_cache_of */
+
+struct slab;
+
+/* Per-CPU stack of free objects. Only touched by its own CPU with
+   interrupts disabled, so no lock is needed */
+struct slab_magazine
+{
+  unsigned int count;
+  void        *objects[SLAB_MAGAZINE_SIZE];
+}
+ALIGNED (CACHE_LINE_SIZE);
+
+struct slab_cache
+{
+  struct slab_magazine magazines[CPU_MAX];
+
+  const char          *name;
+  size_t               size;      /* Slot size, including alignment */
+  size_t               align;
+  unsigned int         flags;
+  unsigned int         order;     /* Each slab takes 2^order frames */
+  unsigned int         per_slab;  /* Objects per slab */
+  size_t               offset;    /* Offset of the first object in a slab */
+  void               (*ctor) (void *);
+
+  spin_t               lock;
+  struct slab         *partial;
+  struct slab         *full;
+  struct slab         *empty;
+  unsigned int         empty_count;
+  size_t               slabs;
+  size_t               grabbed;   /* Objects out of slabs (including magazines) */
+
+  struct slab_cache   *next;
+}
+ALIGNED (CACHE_LINE_SIZE);
+
+struct slab_stats
+{
+  size_t objects_inuse;  /* Handed out to callers */
+  size_t objects_cached; /* Sitting in per-CPU magazines */
+  size_t objects_free;   /* Free inside slabs */
+  size_t slabs;
+  size_t bytes;          /* Memory taken by the slabs */
+};
+
+void slab_init (void);
+
+/* Objects are constructed with CTOR (if not NULL) only once, when their slab
+   is created. They must be given back to the cache in constructed state. */
+struct slab_cache *slab_cache_create (
+  const char *,
+  size_t,
+  size_t,
+  unsigned int,
+  void (*) (void *));
+
+/* Cache an object belongs to. Only for SLAB_SINGLE_FRAME caches. */
+struct slab_cache *slab_cache_of (void *);
+
+void *slab_alloc (struct slab_cache *);
+void  slab_free (struct slab_cache *, void *);
+
+void  slab_cache_stats (struct slab_cache *, struct slab_stats *);
+void  slab_dump (void);
+
+#endif /* _SLAB_H */
@@ -0,0 +1,429 @@
+/*
+ *    slab.c: Object caches for fixed-size kernel objects
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <frame.h>
+#include <slab.h>
+
+/* Slabs are naturally aligned blocks of 2^order frames, starting with
+   this header. Free objects are tracked by index, so their contents
+   (which the constructor set up) are never touched. */
+struct slab
+{
+  struct slab_cache *cache;
+  struct slab       *next;
+  struct slab       *prev;
+  char              *base;     /* First object */
+  unsigned int       inuse;
+  unsigned int       nfree;
+  uint16_t           free[];   /* Stack of free object indices */
+};
+
+/* Cache of caches, needed to bootstrap the allocator */
+static struct slab_cache slab_cache_cache;
+
+static struct slab_cache *slab_caches;
+static spin_t             slab_caches_lock = SPIN_UNLOCKED;
+
+static void
+slab_list_insert (struct slab **head, struct slab *slab)
+{
+  slab->prev = NULL;
+  slab->next = *head;
+
+  if (*head != NULL)
+    (*head)->prev = slab;
+
+  *head = slab;
+}
+
+static void
+slab_list_remove (struct slab **head, struct slab *slab)
+{
+  if (slab->prev != NULL)
+    slab->prev->next = slab->next;
+  else
+    *head = slab->next;
+
+  if (slab->next != NULL)
+    slab->next->prev = slab->prev;
+}
+
+static inline struct slab *
+slab_of (struct slab_cache *cache, void *obj)
+{
+  return (struct slab *) ((uintptr_t) obj & ~((PAGE_SIZE << cache->order) - 1));
+}
+
+static struct slab *
+slab_create (struct slab_cache *cache)
+{
+  struct slab *slab;
+  uintptr_t frame;
+  unsigned int i;
+
+  if ((frame = frame_alloc_pages (cache->order)) == FRAME_INVALID)
+    return NULL;
+
+  slab = (struct slab *) PHYS_TO_VIRT (frame);
+
+  slab->cache = cache;
+  slab->base  = (char *) slab + cache->offset;
+  slab->inuse = 0;
+  slab->nfree = cache->per_slab;
+
+  /* Lower addresses are handed out first */
+  for (i = 0; i < cache->per_slab; ++i)
+  {
+    slab->free[i] = cache->per_slab - i - 1;
+
+    if (cache->ctor != NULL)
+      (cache->ctor) (slab->base + i * cache->size);
+  }
+
+  ++cache->slabs;
+
+  return slab;
+}
+
+static void
+slab_destroy (struct slab_cache *cache, struct slab *slab)
+{
+  frame_free_pages (VIRT_TO_PHYS (slab), cache->order);
+
+  --cache->slabs;
+}
+
+/* Take an object from the slabs. Cache lock must be held. */
+static void *
+slab_cache_grab (struct slab_cache *cache)
+{
+  struct slab *slab;
+  void *obj;
+
+  if ((slab = cache->partial) == NULL)
+  {
+    if ((slab = cache->empty) != NULL)
+    {
+      slab_list_remove (&cache->empty, slab);
+      --cache->empty_count;
+    }
+    else if ((slab = slab_create (cache)) == NULL)
+      return NULL;
+
+    slab_list_insert (&cache->partial, slab);
+  }
+
+  obj = slab->base + slab->free[--slab->nfree] * cache->size;
+
+  ++slab->inuse;
+  ++cache->grabbed;
+
+  if (slab->nfree == 0)
+  {
+    slab_list_remove (&cache->partial, slab);
+    slab_list_insert (&cache->full, slab);
+  }
+
+  return obj;
+}
+
+/* Give an object back to its slab. Cache lock must be held. */
+static void
+slab_cache_put (struct slab_cache *cache, void *obj)
+{
+  struct slab *slab = slab_of (cache, obj);
+
+  if (slab->nfree == 0)
+  {
+    slab_list_remove (&cache->full, slab);
+    slab_list_insert (&cache->partial, slab);
+  }
+
+  slab->free[slab->nfree++] = ((char *) obj - slab->base) / cache->size;
+
+  --slab->inuse;
+  --cache->grabbed;
+
+  /* Keep a single empty slab around, release the rest */
+  if (slab->inuse == 0)
+  {
+    slab_list_remove (&cache->partial, slab);
+
+    if (cache->empty_count == 0)
+    {
+      slab_list_insert (&cache->empty, slab);
+      ++cache->empty_count;
+    }
+    else
+      slab_destroy (cache, slab);
+  }
+}
+
+static void
+slab_magazine_refill (struct slab_cache *cache, struct slab_magazine *mag)
+{
+  void *obj;
+
+  spin_lock (&cache->lock);
+
+  while (mag->count < SLAB_BATCH && (obj = slab_cache_grab (cache)) != NULL)
+    mag->objects[mag->count++] = obj;
+
+  spin_unlock (&cache->lock);
+}
+
+static void
+slab_magazine_flush (struct slab_cache *cache, struct slab_magazine *mag)
+{
+  unsigned int i;
+
+  spin_lock (&cache->lock);
+
+  for (i = 0; i < SLAB_BATCH && mag->count > 0; ++i)
+    slab_cache_put (cache, mag->objects[--mag->count]);
+
+  spin_unlock (&cache->lock);
+}
+
+void *
+slab_alloc (struct slab_cache *cache)
+{
+  struct slab_magazine *mag;
+  uintptr_t flags;
+  void *obj = NULL;
+
+  flags = __arch_irq_save ();
+
+  mag = &cache->magazines[__arch_cpu_id ()];
+
+  if (mag->count == 0)
+    slab_magazine_refill (cache, mag);
+
+  if (mag->count > 0)
+    obj = mag->objects[--mag->count];
+
+  __arch_irq_restore (flags);
+
+  return obj;
+}
+
+void
+slab_free (struct slab_cache *cache, void *obj)
+{
+  struct slab_magazine *mag;
+  uintptr_t flags;
+
+  flags = __arch_irq_save ();
+
+  mag = &cache->magazines[__arch_cpu_id ()];
+
+  if (mag->count == SLAB_MAGAZINE_SIZE)
+    slab_magazine_flush (cache, mag);
+
+  mag->objects[mag->count++] = obj;
+
+  __arch_irq_restore (flags);
+}
+
+/* Choose the smallest slab size that wastes less than 1/8 of it */
+static void
+slab_cache_layout (struct slab_cache *cache)
+{
+  size_t bytes, header, waste;
+  unsigned int order, max_order, count;
+
+  max_order = (cache->flags & SLAB_SINGLE_FRAME) ? 0 : SLAB_MAX_ORDER;
+
+  for (order = 0; order <= max_order; ++order)
+  {
+    bytes = PAGE_SIZE << order;
+    count = (bytes - sizeof (struct slab)) / (cache->size + sizeof (uint16_t));
+
+    while (count > 0)
+    {
+      header = __ALIGN (sizeof (struct slab) + count * sizeof (uint16_t), cache->align);
+
+      if (header + count * cache->size <= bytes)
+        break;
+
+      --count;
+    }
+
+    if (count == 0)
+      continue;
+
+    cache->order    = order;
+    cache->per_slab = count;
+    cache->offset   = header;
+
+    waste = bytes - header - count * cache->size;
+
+    if (waste <= bytes / 8)
+      break;
+  }
+}
+
+static int
+slab_cache_setup (
+  struct slab_cache *cache,
+  const char *name,
+  size_t size,
+  size_t align,
+  unsigned int cache_flags,
+  void (*ctor) (void *))
+{
+  uintptr_t flags;
+
+  memset (cache, 0, sizeof (struct slab_cache));
+
+  cache->flags = cache_flags;
+
+  /* Objects never straddle more cache lines than needed: big objects
+     start at a line boundary, small ones at a fraction of it */
+  if (align < sizeof (void *))
+    align = sizeof (void *);
+
+  if (align < CACHE_LINE_SIZE)
+  {
+    cache->align = CACHE_LINE_SIZE;
+
+    while (cache->align / 2 >= size && cache->align / 2 >= align)
+      cache->align /= 2;
+  }
+  else
+    cache->align = align;
+
+  cache->name = name;
+  cache->size = __ALIGN (size, cache->align);
+  cache->ctor = ctor;
+  cache->lock = SPIN_UNLOCKED;
+
+  slab_cache_layout (cache);
+
+  if (cache->per_slab == 0)
+    return 0;
+
+  flags = spin_lock_irqsave (&slab_caches_lock);
+
+  cache->next = slab_caches;
+  slab_caches = cache;
+
+  spin_unlock_irqrestore (&slab_caches_lock, flags);
+
+  return 1;
+}
+
+struct slab_cache *
+slab_cache_create (
+  const char *name,
+  size_t size,
+  size_t align,
+  unsigned int flags,
+  void (*ctor) (void *))
+{
+  struct slab_cache *cache;
+
+  if (size == 0 || size > (PAGE_SIZE << SLAB_MAX_ORDER) / 2)
+    return NULL;
+
+  if ((cache = slab_alloc (&slab_cache_cache)) == NULL)
+    return NULL;
+
+  if (!slab_cache_setup (cache, name, size, align, flags, ctor))
+  {
+    slab_free (&slab_cache_cache, cache);
+    return NULL;
+  }
+
+  return cache;
+}
+
+struct slab_cache *
+slab_cache_of (void *obj)
+{
+  return ((struct slab *) PAGE_START ((uintptr_t) obj))->cache;
+}
+
+void
+slab_cache_stats (struct slab_cache *cache, struct slab_stats *stats)
+{
+  unsigned int i;
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&cache->lock);
+
+  stats->objects_cached = 0;
+
+  for (i = 0; i < CPU_MAX; ++i)
+    stats->objects_cached += cache->magazines[i].count;
+
+  stats->slabs          = cache->slabs;
+  stats->bytes          = cache->slabs * (PAGE_SIZE << cache->order);
+  stats->objects_free   = cache->slabs * cache->per_slab - cache->grabbed;
+  stats->objects_inuse  = cache->grabbed - stats->objects_cached;
+
+  spin_unlock_irqrestore (&cache->lock, flags);
+}
+
+void
+slab_dump (void)
+{
+  struct slab_cache *cache;
+  struct slab_stats stats;
+  size_t capacity;
+
+  printf ("%-16s %6s %6s %8s %8s %8s %6s %5s\n",
+          "cache", "size", "align", "inuse", "cached", "free", "slabs", "frag");
+
+  for (cache = slab_caches; cache != NULL; cache = cache->next)
+  {
+    slab_cache_stats (cache, &stats);
+
+    /* Fragmentation: share of slab capacity not backing live objects */
+    capacity = stats.slabs * cache->per_slab;
+
+    printf ("%-16s %6zu %6zu %8zu %8zu %8zu %6zu %4zu%%\n",
+            cache->name,
+            cache->size,
+            cache->align,
+            stats.objects_inuse,
+            stats.objects_cached,
+            stats.objects_free,
+            stats.slabs,
+            capacity ? 100 * (capacity - stats.objects_inuse) / capacity : 0);
+  }
+}
+
+void
+slab_init (void)
+{
+  (void) slab_cache_setup (
+    &slab_cache_cache,
+    "slab_cache",
+    sizeof (struct slab_cache),
+    CACHE_LINE_SIZE,
+    0,
+    NULL);
+}
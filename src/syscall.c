@@ -0,0 +1,193 @@
+/*
+ *    syscall.c: System call dispatch
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+
+#include <errno.h>
+#include <stddef.h>
+
+#include <endpoint.h>
+#include <notification.h>
+#include <syscall.h>
+
+static uintptr_t
+sys_null (uintptr_t *args)
+{
+  return 0;
+}
+
+static uintptr_t
+sys_endpoint_create (uintptr_t *args)
+{
+  struct endpoint *ep;
+
+  if ((ep = endpoint_create ()) == NULL)
+    return -ENOMEM;
+
+  return ep->id;
+}
+
+/* IPC calls: the endpoint, then the message words */
+static uintptr_t
+sys_send (uintptr_t *args)
+{
+  struct endpoint *ep;
+
+  if ((ep = endpoint_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  return endpoint_send (ep, args + 1);
+}
+
+static uintptr_t
+sys_recv (uintptr_t *args)
+{
+  struct endpoint *ep;
+
+  if ((ep = endpoint_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  return endpoint_recv (ep, args + 1);
+}
+
+static uintptr_t
+sys_call (uintptr_t *args)
+{
+  struct endpoint *ep;
+
+  if ((ep = endpoint_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  return endpoint_call (ep, args + 1);
+}
+
+static uintptr_t
+sys_reply_recv (uintptr_t *args)
+{
+  struct endpoint *ep;
+
+  if ((ep = endpoint_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  return endpoint_reply_recv (ep, args + 1);
+}
+
+static uintptr_t
+sys_notification_create (uintptr_t *args)
+{
+  struct notification *ntfn;
+
+  if ((ntfn = notification_create ()) == NULL)
+    return -ENOMEM;
+
+  return ntfn->id;
+}
+
+static uintptr_t
+sys_signal (uintptr_t *args)
+{
+  struct notification *ntfn;
+
+  if ((ntfn = notification_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  notification_signal (ntfn, args[1]);
+
+  return 0;
+}
+
+static uintptr_t
+sys_wait (uintptr_t *args)
+{
+  struct notification *ntfn;
+
+  if ((ntfn = notification_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  args[1] = notification_wait (ntfn);
+
+  return 0;
+}
+
+static uintptr_t
+sys_poll (uintptr_t *args)
+{
+  struct notification *ntfn;
+
+  if ((ntfn = notification_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  args[1] = notification_poll (ntfn);
+
+  return 0;
+}
+
+static uintptr_t
+sys_irq_bind (uintptr_t *args)
+{
+  struct notification *ntfn;
+
+  if ((ntfn = notification_lookup (args[0])) == NULL)
+    return -EBADF;
+
+  if (notification_bind_irq (ntfn, args[1], args[2]) == -1)
+    return -EBUSY;
+
+  return 0;
+}
+
+static uintptr_t
+sys_irq_ack (uintptr_t *args)
+{
+  if (notification_irq_ack (args[0]) == -1)
+    return -EINVAL;
+
+  return 0;
+}
+
+static const syscall_t syscall_table[SYS_COUNT] =
+{
+  [SYS_NULL]            = sys_null,
+  [SYS_ENDPOINT_CREATE] = sys_endpoint_create,
+  [SYS_SEND]            = sys_send,
+  [SYS_RECV]            = sys_recv,
+  [SYS_CALL]            = sys_call,
+  [SYS_REPLY_RECV]      = sys_reply_recv,
+  [SYS_NOTIFICATION_CREATE] = sys_notification_create,
+  [SYS_SIGNAL]          = sys_signal,
+  [SYS_WAIT]            = sys_wait,
+  [SYS_POLL]            = sys_poll,
+  [SYS_IRQ_BIND]        = sys_irq_bind,
+  [SYS_IRQ_ACK]         = sys_irq_ack
+};
+
+uintptr_t
+syscall_dispatch (uintptr_t nr, uintptr_t *args)
+{
+  if (nr >= SYS_COUNT || syscall_table[nr] == NULL)
+    return -ENOSYS;
+
+  return (syscall_table[nr]) (args);
+}
+
+void
+syscall_init (void)
+{
+  __arch_syscall_init (syscall_dispatch);
+}
@@ -0,0 +1,149 @@
+/*
+ *    clock.c: Cycle counter clocksource
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <seqlock.h>
+#include <spinlock.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <frame.h>
+#include <clock.h>
+
+/* Kernel-side copy of the conversion parameters, so that the time page
+   is only ever read by userland */
+static uint32_t clock_mult;
+static uint32_t clock_shift;
+static uint32_t clock_inv_mult;
+static uint32_t clock_inv_shift;
+static uint64_t clock_cycle_base;
+
+static int64_t  clock_realtime_offset;
+
+static spin_t   clock_lock;
+
+static struct atomik_time_page *clock_page;
+static uintptr_t clock_page_frame;
+
+/* Largest SHIFT such that FROM / TO == MULT / 2^SHIFT with MULT still
+   fitting in 32 bits. The only divisions the clock ever does. */
+static void
+clock_compute_mult_shift (uint32_t *mult, uint32_t *shift, uint32_t from, uint32_t to)
+{
+  uint64_t m;
+  uint32_t s;
+
+  for (s = 32; s > 1; --s)
+    if (((m = ((uint64_t) from << s) / to) >> 32) == 0)
+      break;
+
+  *mult  = m;
+  *shift = s;
+}
+
+uint64_t
+clock_cycles_to_ns (uint64_t cycles)
+{
+  return atomik_cycles_to_ns (cycles, clock_mult, clock_shift);
+}
+
+uint64_t
+clock_ns_to_cycles (uint64_t ns)
+{
+  return atomik_cycles_to_ns (ns, clock_inv_mult, clock_inv_shift);
+}
+
+uint64_t
+clock_monotonic (void)
+{
+  return clock_cycles_to_ns (__arch_cycles () - clock_cycle_base);
+}
+
+int64_t
+clock_realtime (void)
+{
+  return clock_monotonic () + clock_realtime_offset;
+}
+
+void
+clock_set_realtime (int64_t ns)
+{
+  uintptr_t flags;
+
+  flags = spin_lock_irqsave (&clock_lock);
+
+  clock_realtime_offset = ns - clock_monotonic ();
+
+  if (clock_page != NULL)
+  {
+    seq_write_begin (&clock_page->seq);
+
+    clock_page->realtime_offset = clock_realtime_offset;
+
+    seq_write_end (&clock_page->seq);
+  }
+
+  spin_unlock_irqrestore (&clock_lock, flags);
+}
+
+uintptr_t
+clock_time_page_frame (void)
+{
+  return clock_page_frame;
+}
+
+const struct atomik_time_page *
+clock_time_page (void)
+{
+  return clock_page;
+}
+
+void
+clock_init (void)
+{
+  uint32_t khz = __arch_cycles_khz ();
+
+  /* ns per cycle is 10^6 / khz, cycles per ns is khz / 10^6 */
+  clock_compute_mult_shift (&clock_mult, &clock_shift, 1000000, khz);
+  clock_compute_mult_shift (&clock_inv_mult, &clock_inv_shift, khz, 1000000);
+
+  clock_cycle_base = __arch_cycles ();
+
+  if ((clock_page_frame = frame_alloc ()) == FRAME_INVALID)
+  {
+    printf ("clock: cannot allocate time page\n");
+    return;
+  }
+
+  clock_page = (struct atomik_time_page *) PHYS_TO_VIRT (clock_page_frame);
+
+  memset (clock_page, 0, PAGE_SIZE);
+
+  seq_write_begin (&clock_page->seq);
+
+  clock_page->version         = ATOMIK_TIME_PAGE_VERSION;
+  clock_page->mult            = clock_mult;
+  clock_page->shift           = clock_shift;
+  clock_page->cycle_base      = clock_cycle_base;
+  clock_page->ns_base         = 0;
+  clock_page->realtime_offset = clock_realtime_offset;
+
+  seq_write_end (&clock_page->seq);
+}
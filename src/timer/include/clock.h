@@ -0,0 +1,45 @@
+/*
+ *    clock.h: Cycle counter clocksource
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <atomik/atomik.h>
+#include <atomik/timepage.h>
+
+/* Nanoseconds since clock_init */
+uint64_t clock_monotonic (void);
+
+/* Wall-clock time, in nanoseconds since the Epoch */
+int64_t  clock_realtime (void);
+void     clock_set_realtime (int64_t);
+
+/* Conversions between cycle counts (as used by timers) and nanoseconds.
+   Multiply and shift only. */
+uint64_t clock_cycles_to_ns (uint64_t);
+uint64_t clock_ns_to_cycles (uint64_t);
+
+/* Physical frame holding the time page, to be mapped read-only in
+   userland */
+uintptr_t clock_time_page_frame (void);
+
+const struct atomik_time_page *clock_time_page (void);
+
+void clock_init (void);
+
+#endif /* _CLOCK_H */
@@ -0,0 +1,64 @@
+/*
+ *    timer.h: Tickless one-shot timers
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include <atomik/atomik.h>
+
+/* Armed timers per CPU */
+#define TIMER_QUEUE_SIZE 256
+
+#define TIMER_IDLE       ((unsigned int) -1)
+
+struct timer
+{
+  uint64_t     deadline;   /* In __arch_cycles () units */
+  unsigned int cpu;        /* Queue it is armed in */
+  unsigned int index;      /* Position in that queue, or TIMER_IDLE */
+
+  void (*func) (struct timer *, void *);
+  void *data;
+};
+
+/* Prepare a timer that calls FUNC (TIMER, DATA) from interrupt context
+   when it expires. FUNC may re-arm it. */
+void timer_setup (struct timer *, void (*) (struct timer *, void *), void *);
+
+/* Arm (or re-arm, if already armed) a timer on the current CPU for an
+   absolute deadline. O(log n). Returns -1 if the queue is full. */
+int  timer_arm (struct timer *, uint64_t);
+
+/* Same, DELTA cycles from now */
+int  timer_arm_in (struct timer *, uint64_t);
+
+/* Disarm. O(log n). Returns 0 if the timer was armed. */
+int  timer_cancel (struct timer *);
+
+static inline int
+timer_pending (const struct timer *timer)
+{
+  return timer->index != TIMER_IDLE;
+}
+
+/* Timer deadlines are expressed in these units */
+uint64_t timer_now (void);
+
+void timer_init (void);
+
+#endif /* _TIMER_H */
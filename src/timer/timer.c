@@ -0,0 +1,241 @@
+/*
+ *    timer.c: Tickless one-shot timers
+ *    Copyright (C) 2015  Gonzalo J. Carracedo
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include <atomik/atomik.h>
+#include <arch.h>
+#include <spinlock.h>
+
+#include <timer.h>
+
+/* Binary min-heap of armed timers, ordered by deadline. The hardware
+   timer is always programmed for the root, and nothing at all when the
+   heap is empty: there are no periodic ticks. */
+struct timer_queue
+{
+  spin_t        lock;
+  unsigned int  count;
+  struct timer *heap[TIMER_QUEUE_SIZE];
+} __attribute__ ((aligned (CACHE_LINE_SIZE)));
+
+static struct timer_queue timer_queues[CPU_MAX];
+
+static inline void
+timer_queue_place (struct timer_queue *queue, struct timer *timer, unsigned int index)
+{
+  queue->heap[index] = timer;
+  timer->index = index;
+}
+
+static void
+timer_queue_sift_up (struct timer_queue *queue, unsigned int index)
+{
+  struct timer *timer = queue->heap[index];
+  unsigned int parent;
+
+  while (index > 0)
+  {
+    parent = (index - 1) / 2;
+
+    if (queue->heap[parent]->deadline <= timer->deadline)
+      break;
+
+    timer_queue_place (queue, queue->heap[parent], index);
+
+    index = parent;
+  }
+
+  timer_queue_place (queue, timer, index);
+}
+
+static void
+timer_queue_sift_down (struct timer_queue *queue, unsigned int index)
+{
+  struct timer *timer = queue->heap[index];
+  unsigned int child;
+
+  while ((child = 2 * index + 1) < queue->count)
+  {
+    if (child + 1 < queue->count &&
+        queue->heap[child + 1]->deadline < queue->heap[child]->deadline)
+      ++child;
+
+    if (timer->deadline <= queue->heap[child]->deadline)
+      break;
+
+    timer_queue_place (queue, queue->heap[child], index);
+
+    index = child;
+  }
+
+  timer_queue_place (queue, timer, index);
+}
+
+static void
+timer_queue_remove (struct timer_queue *queue, struct timer *timer)
+{
+  unsigned int index = timer->index;
+  struct timer *last = queue->heap[--queue->count];
+
+  timer->index = TIMER_IDLE;
+
+  if (last != timer)
+  {
+    timer_queue_place (queue, last, index);
+
+    timer_queue_sift_down (queue, index);
+    timer_queue_sift_up (queue, last->index);
+  }
+}
+
+static void
+timer_queue_program (struct timer_queue *queue)
+{
+  __arch_timer_set_deadline (queue->count > 0 ? queue->heap[0]->deadline : 0);
+}
+
+void
+timer_setup (struct timer *timer, void (*func) (struct timer *, void *), void *data)
+{
+  timer->deadline = 0;
+  timer->cpu      = 0;
+  timer->index    = TIMER_IDLE;
+  timer->func     = func;
+  timer->data     = data;
+}
+
+int
+timer_cancel (struct timer *timer)
+{
+  struct timer_queue *queue = &timer_queues[timer->cpu];
+  uintptr_t flags;
+  int ret = -1;
+
+  flags = spin_lock_irqsave (&queue->lock);
+
+  /* If it was the root, the hardware timer fires for nothing and gets
+     reprogrammed then: cheaper than doing it now */
+  if (timer_pending (timer))
+  {
+    timer_queue_remove (queue, timer);
+
+    ret = 0;
+  }
+
+  spin_unlock_irqrestore (&queue->lock, flags);
+
+  return ret;
+}
+
+int
+timer_arm (struct timer *timer, uint64_t deadline)
+{
+  struct timer_queue *queue;
+  uintptr_t flags;
+  unsigned int cpu;
+
+  flags = __arch_irq_save ();
+
+  cpu = __arch_cpu_id ();
+
+  /* Armed in another CPU's queue: take it out of there first */
+  if (timer_pending (timer) && timer->cpu != cpu)
+    (void) timer_cancel (timer);
+
+  queue = &timer_queues[cpu];
+
+  spin_lock (&queue->lock);
+
+  if (timer_pending (timer))
+  {
+    timer->deadline = deadline;
+
+    timer_queue_sift_down (queue, timer->index);
+    timer_queue_sift_up (queue, timer->index);
+  }
+  else
+  {
+    if (queue->count == TIMER_QUEUE_SIZE)
+    {
+      spin_unlock (&queue->lock);
+      __arch_irq_restore (flags);
+
+      return -1;
+    }
+
+    timer->deadline = deadline;
+    timer->cpu      = cpu;
+
+    timer_queue_place (queue, timer, queue->count++);
+    timer_queue_sift_up (queue, timer->index);
+  }
+
+  if (queue->heap[0] == timer)
+    timer_queue_program (queue);
+
+  spin_unlock (&queue->lock);
+
+  __arch_irq_restore (flags);
+
+  return 0;
+}
+
+int
+timer_arm_in (struct timer *timer, uint64_t delta)
+{
+  return timer_arm (timer, timer_now () + delta);
+}
+
+uint64_t
+timer_now (void)
+{
+  return __arch_cycles ();
+}
+
+/* Runs with interrupts disabled */
+static void
+timer_interrupt (void)
+{
+  struct timer_queue *queue = &timer_queues[__arch_cpu_id ()];
+  struct timer *timer;
+
+  spin_lock (&queue->lock);
+
+  while (queue->count > 0 && queue->heap[0]->deadline <= timer_now ())
+  {
+    timer = queue->heap[0];
+
+    timer_queue_remove (queue, timer);
+
+    /* The callback may well arm timers of its own */
+    spin_unlock (&queue->lock);
+
+    (timer->func) (timer, timer->data);
+
+    spin_lock (&queue->lock);
+  }
+
+  timer_queue_program (queue);
+
+  spin_unlock (&queue->lock);
+}
+
+void
+timer_init (void)
+{
+  __arch_timer_init (timer_interrupt);
+}
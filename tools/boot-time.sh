@@ -0,0 +1,118 @@
+#!/bin/sh
+#
+#  boot-time.sh: Boot an Atomik image several times under QEMU and report
+#  the median time it takes to reach the end of the boot profile.
+#
+#  Copyright (C) 2015  Gonzalo J. Carracedo
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>
+#
+
+RUNS=10
+QEMU=qemu-system-i386
+TIMEOUT=30
+MARKER="Boot profile: total"
+
+usage ()
+{
+  echo "Usage: $0 [-n RUNS] [-q QEMU] [-t TIMEOUT] KERNEL" >&2
+  exit 1
+}
+
+while getopts "n:q:t:" opt; do
+  case $opt in
+    n) RUNS="$OPTARG" ;;
+    q) QEMU="$OPTARG" ;;
+    t) TIMEOUT="$OPTARG" ;;
+    *) usage ;;
+  esac
+done
+
+shift $((OPTIND - 1))
+
+[ $# -eq 1 ] || usage
+
+KERNEL="$1"
+
+if ! command -v "$QEMU" > /dev/null 2>&1; then
+  echo "$0: $QEMU not found" >&2
+  exit 1
+fi
+
+TMPDIR=`mktemp -d` || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+now_ns ()
+{
+  date +%s%N
+}
+
+# Wall-clock time from QEMU start until the kernel prints its boot
+# profile, plus the total the kernel itself measured with the TSC
+boot_once ()
+{
+  LOG="$TMPDIR/serial.log"
+  : > "$LOG"
+
+  START=`now_ns`
+
+  "$QEMU" -kernel "$KERNEL" -display none -serial file:"$LOG" \
+          -monitor none -no-reboot &
+  PID=$!
+
+  DEADLINE=$((`date +%s` + TIMEOUT))
+
+  while ! grep -q "$MARKER" "$LOG"; do
+    if [ `date +%s` -ge $DEADLINE ] || ! kill -0 $PID 2> /dev/null; then
+      kill $PID 2> /dev/null
+      wait $PID 2> /dev/null
+      return 1
+    fi
+    sleep 0.01
+  done
+
+  END=`now_ns`
+
+  kill $PID 2> /dev/null
+  wait $PID 2> /dev/null
+
+  KERNEL_US=`grep "$MARKER" "$LOG" | sed 's/.*(\([0-9]*\) us).*/\1/'`
+
+  echo "$(((END - START) / 1000)) $KERNEL_US"
+}
+
+median ()
+{
+  sort -n | awk '{ v[NR] = $1 } END { if (NR % 2) print v[(NR + 1) / 2]; else print int((v[NR / 2] + v[NR / 2 + 1]) / 2) }'
+}
+
+: > "$TMPDIR/wall"
+: > "$TMPDIR/kernel"
+
+i=1
+while [ $i -le $RUNS ]; do
+  if ! RESULT=`boot_once`; then
+    echo "$0: run $i did not finish booting within $TIMEOUT s" >&2
+    exit 1
+  fi
+
+  set -- $RESULT
+  echo "run $i: $1 us wall-clock, $2 us in kernel"
+  echo $1 >> "$TMPDIR/wall"
+  echo $2 >> "$TMPDIR/kernel"
+
+  i=$((i + 1))
+done
+
+echo "median over $RUNS runs: `median < "$TMPDIR/wall"` us wall-clock, `median < "$TMPDIR/kernel"` us in kernel"
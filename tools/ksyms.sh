@@ -0,0 +1,73 @@
+#!/bin/sh
+#
+#  ksyms.sh: Generate the kernel symbol table from a first-pass link of
+#  the kernel. The output is an assembly file filling the debugsyms
+#  section with the layout described in src/include/ksyms.h.
+#
+#  Copyright (C) 2015  Gonzalo J. Carracedo
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>
+#
+
+if [ $# -ne 2 ]; then
+  echo "Usage: $0 NM KERNEL" >&2
+  exit 1
+fi
+
+NM="$1"
+KERNEL="$2"
+
+# Function symbols only, by address. Aliases (text_start and friends)
+# keep the first name; identical names (static functions) share their
+# string.
+$NM -n "$KERNEL" | awk '
+  BEGIN {
+    n = 0
+    m = 0
+  }
+
+  NF == 3 && $2 ~ /^[tTwW]$/ {
+    if ($1 == last)
+      next
+
+    last      = $1
+    addr[n]   = $1
+    name[n++] = $3
+  }
+
+  END {
+    print "/* Generated by ksyms.sh from the first-pass kernel. Do not edit. */"
+    print ""
+    print "        .section debugsyms, \"a\""
+    print "        .align  4"
+    print "        .long   0x4d59534b /* KSYM_MAGIC */"
+    printf "        .long   %d\n", n
+
+    size = 0
+
+    for (i = 0; i < n; ++i)
+    {
+      if (!(name[i] in offset))
+      {
+        offset[name[i]] = size
+        strings[m++]    = name[i]
+        size           += length (name[i]) + 1
+      }
+
+      printf "        .long   0x%s, %d\n", addr[i], offset[name[i]]
+    }
+
+    for (i = 0; i < m; ++i)
+      printf "        .asciz  \"%s\"\n", strings[i]
+  }'
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+#  prof-fold.py: Turn a sampling profiler dump captured from the serial
+#  port into folded stacks, one "outer;...;inner count" line per stack,
+#  ready for flamegraph.pl. Boot with prof=HZ[,DEPTH] to get one.
+#
+#  Copyright (C) 2015  Gonzalo J. Carracedo
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>
+#
+
+import bisect
+import os
+import struct
+import subprocess
+import sys
+
+# Must match src/prof/include/prof.h
+MAGIC   = b"ATMKPROF"
+VERSION = 1
+END     = 0xffffffff
+
+def usage ():
+  sys.stderr.write ("Usage: %s [-c] KERNEL CAPTURE\n" % sys.argv[0])
+  sys.stderr.write ("  -c  Keep samples of each CPU apart\n")
+  sys.exit (1)
+
+def load_symbols (kernel):
+  nm = os.environ.get ("NM", "nm")
+  out = subprocess.check_output ([nm, "-n", kernel]).decode ()
+  addrs = []
+  names = []
+
+  for line in out.splitlines ():
+    fields = line.split ()
+    if len (fields) == 3 and fields[1] in "tTwW":
+      # Aliases (text_start and the like): keep the first name only
+      if addrs and addrs[-1] == int (fields[0], 16):
+        continue
+
+      addrs.append (int (fields[0], 16))
+      names.append (fields[2])
+
+  return addrs, names
+
+def symbolise (symbols, addr):
+  addrs, names = symbols
+  i = bisect.bisect_right (addrs, addr) - 1
+
+  return names[i] if i >= 0 else "0x%08x" % addr
+
+def parse_dump (data, offset):
+  words = lambda n, at: struct.unpack_from ("<%dI" % n, data, at)
+
+  version, hz = words (2, offset + len (MAGIC))
+  if version != VERSION:
+    raise ValueError ("unsupported dump version %d" % version)
+
+  offset += len (MAGIC) + 8
+  cpus = []
+
+  while True:
+    cpu, count, dropped = words (3, offset)
+    offset += 12
+
+    if cpu == END:
+      break
+
+    samples = []
+    body = words (count, offset)
+    offset += 4 * count
+    i = 0
+
+    while i < count:
+      n = body[i]
+      samples.append (body[i + 1:i + 1 + n])
+      i += n + 1
+
+    cpus.append ((cpu, dropped, samples))
+
+  return hz, cpus
+
+def main ():
+  args = sys.argv[1:]
+  per_cpu = False
+
+  if args and args[0] == "-c":
+    per_cpu = True
+    args = args[1:]
+
+  if len (args) != 2:
+    usage ()
+
+  symbols = load_symbols (args[0])
+
+  with open (args[1], "rb") as f:
+    data = f.read ()
+
+  # The capture may hold several dumps among regular console output
+  folded = {}
+  offset = data.find (MAGIC)
+
+  if offset == -1:
+    sys.stderr.write ("%s: no profiler dump found\n" % args[1])
+    sys.exit (1)
+
+  while offset != -1:
+    hz, cpus = parse_dump (data, offset)
+
+    for cpu, dropped, samples in cpus:
+      if dropped > 0:
+        sys.stderr.write ("cpu%d: %d samples dropped\n" % (cpu, dropped))
+
+      for pcs in samples:
+        # Return addresses point past the call: look up the call itself
+        frames = [symbolise (symbols, pcs[0])]
+        frames += [symbolise (symbols, pc - 1) for pc in pcs[1:]]
+        frames.reverse ()
+
+        if per_cpu:
+          frames.insert (0, "cpu%d" % cpu)
+
+        stack = ";".join (frames)
+        folded[stack] = folded.get (stack, 0) + 1
+
+    offset = data.find (MAGIC, offset + len (MAGIC))
+
+  for stack in sorted (folded):
+    print ("%s %d" % (stack, folded[stack]))
+
+if __name__ == "__main__":
+  main ()